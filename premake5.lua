@@ -58,3 +58,4 @@ include "projects/02-pendulum"
 include "projects/03-coupled-pendulum"
 include "projects/04-ray-casting"
 include "projects/05-dear-imgui"
+include "projects/06-c-api"
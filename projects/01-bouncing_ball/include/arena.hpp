@@ -0,0 +1,96 @@
+#ifndef ARENA_HPP
+#define ARENA_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Bump allocator for the transient data of a step (candidate lists, partial sums, scratch).
+// Allocating moves a pointer forward, nothing is freed one by one: the arena is rewound to a
+// mark or reset as a whole. It grows by whole blocks while warming up, and reset() merges them
+// into one block of the largest size seen, so a steady state allocates nothing from the heap.
+// An arena belongs to one thread, frameArena() gives each thread its own.
+class Arena {
+    public:
+        struct Mark {
+            size_t block;
+            size_t offset;
+        };
+
+        explicit Arena(size_t block_bytes = 1 << 16);
+        ~Arena();
+        Arena(const Arena&) = delete;
+        Arena& operator=(const Arena&) = delete;
+
+        void* allocate(size_t bytes, size_t align = alignof(std::max_align_t));
+
+        Mark mark() const { return {current, offset}; };
+        // Frees everything allocated since the mark
+        void rewind(Mark m);
+        // Frees everything
+        void reset();
+
+        // Bytes in use, reserved, and the most ever in use
+        size_t used() const { return used_before + offset; };
+        size_t capacity() const;
+        size_t highWater() const { return high_water; };
+        // Blocks taken from the heap since the start
+        uint64_t heapAllocations() const { return n_allocations; };
+
+    private:
+        struct Block {
+            unsigned char* data;
+            size_t bytes;
+        };
+
+        std::vector<Block> blocks;
+        size_t current;
+        size_t offset;
+        size_t used_before;         // bytes of the blocks before current
+        size_t block_bytes;
+        size_t high_water;
+        uint64_t n_allocations;
+
+        void addBlock(size_t bytes);
+};
+
+// Rewinds the arena to where it was when the scope was entered
+class ArenaScope {
+    public:
+        explicit ArenaScope(Arena& arena): arena(arena), start(arena.mark()) {};
+        ~ArenaScope() { arena.rewind(start); };
+
+    private:
+        Arena& arena;
+        Arena::Mark start;
+};
+
+// STL allocator over an arena: deallocate does nothing, the memory comes back with the arena.
+// A growing container leaves its old buffers behind, reserve() first.
+template<typename T>
+class ArenaAllocator {
+    public:
+        typedef T value_type;
+
+        explicit ArenaAllocator(Arena& arena): arena(&arena) {};
+        template<typename U>
+        ArenaAllocator(const ArenaAllocator<U>& other): arena(other.arena) {};
+
+        T* allocate(size_t n) { return (T*)arena->allocate(n * sizeof(T), alignof(T)); };
+        void deallocate(T*, size_t) {};
+
+        template<typename U>
+        bool operator==(const ArenaAllocator<U>& other) const { return arena == other.arena; };
+        template<typename U>
+        bool operator!=(const ArenaAllocator<U>& other) const { return arena != other.arena; };
+
+        Arena* arena;
+};
+
+template<typename T>
+using ArenaVector = std::vector<T, ArenaAllocator<T>>;
+
+// Arena of the calling thread
+Arena& frameArena();
+
+#endif
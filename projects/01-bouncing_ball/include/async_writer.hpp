@@ -0,0 +1,88 @@
+#ifndef ASYNC_WRITER_HPP
+#define ASYNC_WRITER_HPP
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Asynchronous positional writes into one file from a fixed set of aligned buffers.
+// With io_uring the buffers are registered with the kernel and up to n_buffers writes are in
+// flight, completions are reaped when a buffer is needed again: no thread at all. Without it
+// (old kernel, seccomp, ...) a small pool of threads does the pwrite calls.
+// The file is opened with O_DIRECT when the filesystem accepts it: offsets and sizes passed
+// to submit() must then be multiples of ASYNC_WRITER_ALIGN.
+// acquire(), submit() and flush() are called from one thread at a time, metrics() from any.
+const uint64_t ASYNC_WRITER_ALIGN = 4096;
+
+struct AsyncWriterMetrics {
+    const char* backend = "none";
+    bool direct = false;
+    uint64_t writes = 0;
+    uint64_t bytes = 0;
+    uint32_t in_flight = 0;             // current queue depth
+    uint32_t max_in_flight = 0;
+    double stall = 0.0;                 // seconds acquire() waited for a free buffer
+};
+
+class AsyncWriter {
+    public:
+        AsyncWriter();
+        ~AsyncWriter();
+
+        bool open(const std::string& filename, uint32_t n_buffers, uint64_t buffer_bytes, bool direct = true);
+        // Waits for the writes in flight, then closes the file
+        bool close();
+
+        bool isOpen() const { return fd >= 0; };
+        uint64_t bufferBytes() const { return buffer_bytes; };
+        unsigned char* data(int buffer) { return buffers[buffer]; };
+
+        // A free buffer, waits for a write to complete if they are all in flight
+        int acquire();
+        // Gives a buffer back without writing it
+        void release(int buffer);
+        // Queues the write of the first bytes of buffer at offset, the buffer comes back once written
+        void submit(int buffer, uint64_t bytes, uint64_t offset);
+        // Waits until every submitted write is done, false if one of them failed
+        bool flush();
+
+        AsyncWriterMetrics metrics() const;
+
+    private:
+        struct Ring;
+        struct Job {
+            uint64_t bytes;
+            uint64_t offset;
+            uint64_t written;
+        };
+
+        int fd;
+        uint64_t buffer_bytes;
+        std::vector<unsigned char*> buffers;
+        std::vector<Job> jobs;                  // what each buffer is writing
+        bool failed;
+        AsyncWriterMetrics stats;
+
+        Ring* ring;
+
+        // Thread pool fallback; also guards free and stats for it
+        std::vector<std::thread> pool;
+        mutable std::mutex mutex;
+        std::condition_variable cv;
+        std::deque<int> queue;
+        std::deque<int> free;
+        bool stop;
+
+        bool setupRing(uint32_t entries);
+        void freeRing();
+        void pushRing(int buffer);
+        bool reap(bool wait);
+        void work();
+        void done(int buffer, bool ok);
+};
+
+#endif
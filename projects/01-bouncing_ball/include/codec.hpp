@@ -0,0 +1,31 @@
+#ifndef CODEC_HPP
+#define CODEC_HPP
+
+#include <cstdint>
+
+#include "trajectory.hpp"
+
+// Lossy coding of trajectory chunks. Every column is quantized (positions on 2^position_bits steps
+// across the box, velocities on a fixed step) and predicted from the previous frames of the chunk:
+// each column of a segment takes the order, 1 (previous value) to 3 (constant acceleration), with
+// the shortest residuals. The first frame is coded against zero so chunks stay independently
+// decodable. A residual is split into its bit length, entropy coded with rANS, and the remaining
+// bits stored raw. Particles are cut in segments with their own rANS stream and predictors:
+// segments code and decode in parallel. Version 2 files only use order 1.
+//
+// Coded chunk: time[n_frames] | segment end offsets[n_segments] | segment | segment | ...
+// Segment: rANS bytes, raw words, frequencies[33], orders | rANS stream | raw bits
+
+// Fills origin, step and segment_particles of the header for its schema
+void setupCodec(TrajectoryHeader& header, const TrajectoryCodec& codec);
+
+// Largest coded size of a chunk of n_frames frames
+uint64_t compressedBound(const TrajectoryHeader& header, uint32_t n_frames);
+
+// frames: n_frames frames in the raw layout (see trajectory.hpp). Returns the coded bytes.
+uint64_t encodeChunk(const TrajectoryHeader& header, const unsigned char* frames, uint32_t n_frames, unsigned char* out);
+
+// Back to the raw layout, false if the chunk is corrupt
+bool decodeChunk(const TrajectoryHeader& header, const unsigned char* data, uint64_t bytes, uint32_t n_frames, unsigned char* frames);
+
+#endif
@@ -0,0 +1,51 @@
+#ifndef DIAGNOSTICS_HPP
+#define DIAGNOSTICS_HPP
+
+#include <functional>
+#include <vector>
+#include <glm/glm.hpp>
+
+#include "object.hpp"
+
+struct EnergyStats {
+    double kinetic;
+    double potential;
+    double total;
+    glm::dvec3 momentum;
+
+    // running statistics of the total energy since the first sample
+    double initial;
+    double min;
+    double max;
+    double drift;               // (total - initial) / |initial|
+    unsigned long n_samples;
+};
+
+// Samples total energy and momentum every `every` steps with a parallel, compensated reduction.
+// Each chunk is Kahan-summed, then the chunk sums are added pairwise, so the result does not
+// depend on the number of threads and stays exact enough for millions of particles.
+class EnergyMonitor {
+    public:
+        EnergyMonitor(unsigned int every = 60, double threshold = 0.05);
+
+        unsigned int every;
+        double threshold;
+        // Called once each time |drift| goes past threshold (re-armed when it comes back under).
+        // Prints the statistics by default.
+        std::function<void(const EnergyStats&)> onDrift;
+
+        // Call once per step, returns true when a sample was taken
+        bool update(const std::vector<Sphere>& spheres);
+        void reset();
+
+        const EnergyStats& stats() const { return current; };
+
+    private:
+        unsigned long n_steps;
+        bool alerted;
+        EnergyStats current;
+};
+
+void printEnergyStats(const EnergyStats& stats);
+
+#endif
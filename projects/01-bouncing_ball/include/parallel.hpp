@@ -0,0 +1,24 @@
+#ifndef PARALLEL_HPP
+#define PARALLEL_HPP
+
+#include <cstddef>
+#include <utility>
+
+#include "jobs.hpp"
+
+// Calls f(begin, end) on chunks of at most `grain` elements spread over all the cores.
+// The chunks are jobs of the shared JobSystem, stolen by the idle workers so uneven work still
+// balances, and the caller runs some of them. It can be called from inside a job.
+// Runs inline when the range fits in a single chunk.
+template<typename F>
+void parallel_for(size_t begin, size_t end, size_t grain, F&& f) {
+    if (end <= begin)
+        return;
+    if (end - begin <= grain) {
+        f(begin, end);
+        return;
+    }
+    JobSystem::instance().parallel_for(begin, end, grain, std::forward<F>(f));
+}
+
+#endif
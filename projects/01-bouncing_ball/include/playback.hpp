@@ -0,0 +1,69 @@
+#ifndef PLAYBACK_HPP
+#define PLAYBACK_HPP
+
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <glm/glm.hpp>
+
+#include "object.hpp"
+#include "trajectory.hpp"
+
+// Reads a trajectory file back for display. The file is memory mapped and a background thread keeps
+// the chunk being shown and the next ones (in the play direction) in a small cache: raw chunks are
+// faulted in ahead of time, compressed chunks are decoded. Evicted chunks are dropped from the
+// mapping, so the memory used does not depend on the length of the recording.
+class TrajectoryPlayer {
+    public:
+        TrajectoryPlayer();
+        ~TrajectoryPlayer();
+
+        bool open(const std::string& filename);
+        void close();
+
+        bool isOpen() const { return map != nullptr; };
+        uint64_t frames() const { return header.n_frames; };
+        float dt() const { return header.dt; };
+
+        // Chunk of frame and the next ones in direction (+1 or -1) go to the front of the prefetch queue
+        void request(uint64_t frame, int direction = 1);
+        // Copies the frame into the spheres (radius and color included) if its chunk is cached,
+        // or waits for it when wait is set. Returns false if it is not there.
+        bool load(uint64_t frame, std::vector<Sphere>& spheres, double& time, bool wait = false);
+
+    private:
+        static const int N_SLOTS = 4;
+        static const uint64_t NO_CHUNK = ~0ull;
+
+        struct Slot {
+            uint64_t chunk = NO_CHUNK;
+            bool ready = false;
+            const unsigned char* frames = nullptr;      // raw frames, in the mapping or in decoded
+            std::vector<unsigned char> decoded;
+        };
+
+        unsigned char* map;
+        uint64_t map_bytes;
+        TrajectoryHeader header;
+        uint64_t frame_bytes;
+        std::vector<ChunkInfo> index;
+        std::vector<float> statics;                     // radius, r, g, b columns
+
+        Slot slots[N_SLOTS];
+        std::vector<uint64_t> wanted;                   // chunks to keep, most urgent first
+
+        std::thread prefetcher;
+        std::mutex mutex;
+        std::condition_variable cv;
+        bool stop;
+
+        uint64_t chunkOf(uint64_t frame) const;
+        int find(uint64_t chunk) const;
+        void prefetch();
+        void fetch(Slot& slot, uint64_t chunk);
+};
+
+#endif
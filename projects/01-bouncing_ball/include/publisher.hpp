@@ -0,0 +1,34 @@
+#ifndef PUBLISHER_HPP
+#define PUBLISHER_HPP
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <glm/glm.hpp>
+
+#include "object.hpp"
+#include "shared_state.hpp"
+
+// Writes every completed step into a ring of shared memory slots that other processes read with
+// StateReader (shared_state.hpp). publish() is a plain copy into the next slot, it never waits
+// for the readers.
+class StatePublisher {
+    public:
+        StatePublisher();
+        ~StatePublisher();
+
+        // name is a POSIX shared memory name ("/physics-sim"), removed again by close()
+        bool open(const std::string& name, uint64_t n_particles, uint32_t n_slots = 4);
+        void publish(const std::vector<Sphere>& spheres, double time);
+        void close();
+
+        bool isOpen() const { return header != nullptr; };
+
+    private:
+        std::string name;
+        SharedStateHeader* header;
+        uint64_t bytes;
+        uint64_t step;
+};
+
+#endif
@@ -0,0 +1,43 @@
+#ifndef SCENARIO_HPP
+#define SCENARIO_HPP
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <glm/glm.hpp>
+
+#include "object.hpp"
+
+// Scene description, see resources/scenarios/default.scn for the format:
+//   seed <n>
+//   box center <x y z> size <s>
+//   solver substeps <n> ccd_threshold <f>
+//   species <name>
+//       count <n>
+//       radius <r> | radius uniform <lo hi>
+//       mass <m>                                       (default pi r^2)
+//       position|velocity|color <distribution>
+//   end
+// with <distribution> one of
+//   const <x y z> | uniform <lo.xyz hi.xyz> | ball <center.xyz radius> | normal <mean.xyz sigma>
+struct Scenario {
+    uint32_t seed = 1;
+    glm::vec3 box_center = glm::vec3(0.0f);
+    float box_size = 1.0f;
+    uint32_t n_substeps = 2;
+    float ccd_threshold = 0.5f;
+
+    std::vector<Sphere> spheres;
+};
+
+// FNV-1a, 64 bits
+uint64_t fnv1a(const void* data, size_t bytes, uint64_t hash = 14695981039346656037ull);
+
+// Parses the text and generates the spheres
+bool compileScenario(const std::string& text, Scenario& scenario);
+
+// Loads filename + ".cache" when it was compiled from the same text (same hash),
+// otherwise compiles the text and writes the cache. A cache hit is a single mmap.
+bool loadScenario(const std::string& filename, Scenario& scenario);
+
+#endif
@@ -0,0 +1,180 @@
+#ifndef SHARED_STATE_HPP
+#define SHARED_STATE_HPP
+
+// Layout of the live state published in POSIX shared memory, and a header-only reader for the
+// processes that attach to it (link with -lrt on older glibc). No dependency on the simulation.
+//
+// The segment is a header followed by a ring of slots, one step per slot. Each slot is guarded by
+// a seqlock: its sequence is odd while the publisher writes it. Readers never block the publisher,
+// they read the arrays in place and check afterwards that the sequence did not move.
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+const char SHARED_STATE_MAGIC[8] = {'P', 'H', 'Y', 'S', 'S', 'H', 'M', '1'};
+const uint32_t SHARED_STATE_VERSION = 1;
+const uint64_t SHARED_STATE_ALIGN = 64;
+
+struct SharedStateHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t n_slots;
+    uint64_t n_particles;
+    uint64_t slot_bytes;
+    uint64_t data_offset;               // of slot 0
+    std::atomic<uint64_t> latest;       // newest complete step + 1, 0 before the first one
+};
+
+// Followed by the columns x, y, z, vx, vy, vz of n_particles floats, each 64 bytes aligned
+struct alignas(64) SharedStateSlot {
+    std::atomic<uint64_t> sequence;
+    uint64_t step;
+    double time;
+};
+
+inline uint64_t sharedColumnBytes(uint64_t n_particles) {
+    return (n_particles * sizeof(float) + SHARED_STATE_ALIGN - 1) / SHARED_STATE_ALIGN * SHARED_STATE_ALIGN;
+}
+
+inline uint64_t sharedSlotBytes(uint64_t n_particles) {
+    return sizeof(SharedStateSlot) + 6 * sharedColumnBytes(n_particles);
+}
+
+// Pointers straight into the shared memory, valid as long as StateReader::valid() says so
+struct StateView {
+    uint64_t step;
+    double time;
+    uint64_t n_particles;
+    const float* x;
+    const float* y;
+    const float* z;
+    const float* vx;
+    const float* vy;
+    const float* vz;
+
+    const SharedStateSlot* slot;
+    uint64_t sequence;
+};
+
+class StateReader {
+    public:
+        StateReader(): header(nullptr), bytes(0) {};
+        ~StateReader() { detach(); };
+
+        bool attach(const std::string& name) {
+            detach();
+            int fd = ::shm_open(name.c_str(), O_RDONLY, 0);
+            if (fd < 0)
+                return false;
+            struct stat st;
+            if (::fstat(fd, &st) != 0 || (uint64_t)st.st_size < sizeof(SharedStateHeader)) {
+                ::close(fd);
+                return false;
+            }
+            void* data = ::mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+            ::close(fd);
+            if (data == MAP_FAILED)
+                return false;
+            header = (const SharedStateHeader*)data;
+            bytes = st.st_size;
+            if (std::memcmp(header->magic, SHARED_STATE_MAGIC, sizeof(header->magic)) != 0
+                || header->version != SHARED_STATE_VERSION || header->n_slots == 0
+                || header->data_offset + header->n_slots * header->slot_bytes > bytes) {
+                detach();
+                return false;
+            }
+            return true;
+        };
+
+        void detach() {
+            if (header != nullptr)
+                ::munmap((void*)header, bytes);
+            header = nullptr;
+            bytes = 0;
+        };
+
+        bool isAttached() const { return header != nullptr; };
+        uint64_t particles() const { return header->n_particles; };
+        // Steps published so far
+        uint64_t steps() const { return header->latest.load(std::memory_order_acquire); };
+
+        // Newest complete step, no copy. False if nothing is published yet or the publisher
+        // keeps overwriting the slot (retried a few times first).
+        bool acquire(StateView& view) const {
+            for (int attempt = 0; attempt != 16; ++attempt) {
+                uint64_t latest = steps();
+                if (latest == 0)
+                    return false;
+                const SharedStateSlot* slot = slotOf(latest - 1);
+                uint64_t sequence = slot->sequence.load(std::memory_order_acquire);
+                if (sequence & 1)
+                    continue;
+                fill(slot, view);
+                view.sequence = sequence;
+                if (valid(view))
+                    return true;
+            }
+            return false;
+        };
+
+        // True while the publisher has not started to overwrite the slot of the view: check it
+        // after using the arrays, the data is only consistent if it still holds
+        bool valid(const StateView& view) const {
+            std::atomic_thread_fence(std::memory_order_acquire);
+            return view.slot->sequence.load(std::memory_order_relaxed) == view.sequence;
+        };
+
+        // Copies the newest step into caller arrays of particles() floats each (any can be null)
+        bool copy(uint64_t& step, double& time, float* x, float* y, float* z, float* vx = nullptr, float* vy = nullptr, float* vz = nullptr) const {
+            for (int attempt = 0; attempt != 16; ++attempt) {
+                StateView view;
+                if (!acquire(view))
+                    return false;
+                size_t column = view.n_particles * sizeof(float);
+                if (x) std::memcpy(x, view.x, column);
+                if (y) std::memcpy(y, view.y, column);
+                if (z) std::memcpy(z, view.z, column);
+                if (vx) std::memcpy(vx, view.vx, column);
+                if (vy) std::memcpy(vy, view.vy, column);
+                if (vz) std::memcpy(vz, view.vz, column);
+                if (valid(view)) {
+                    step = view.step;
+                    time = view.time;
+                    return true;
+                }
+            }
+            return false;
+        };
+
+    private:
+        const SharedStateHeader* header;
+        uint64_t bytes;
+
+        const SharedStateSlot* slotOf(uint64_t step) const {
+            return (const SharedStateSlot*)((const char*)header + header->data_offset + (step % header->n_slots) * header->slot_bytes);
+        };
+
+        void fill(const SharedStateSlot* slot, StateView& view) const {
+            uint64_t column = sharedColumnBytes(header->n_particles);
+            const char* first = (const char*)slot + sizeof(SharedStateSlot);
+            view.step = slot->step;
+            view.time = slot->time;
+            view.n_particles = header->n_particles;
+            view.x = (const float*)first;
+            view.y = (const float*)(first + column);
+            view.z = (const float*)(first + 2 * column);
+            view.vx = (const float*)(first + 3 * column);
+            view.vy = (const float*)(first + 4 * column);
+            view.vz = (const float*)(first + 5 * column);
+            view.slot = slot;
+        };
+};
+
+#endif
@@ -0,0 +1,62 @@
+#ifndef SIMULATION_HPP
+#define SIMULATION_HPP
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <thread>
+#include <vector>
+#include <glm/glm.hpp>
+
+#include "object.hpp"
+#include "triple_buffer.hpp"
+
+struct SimState {
+    std::vector<Sphere> spheres;
+    double time = 0.0;
+    uint64_t steps = 0;
+};
+
+// Runs the physics on its own thread with a fixed step, so it goes on while the render thread
+// waits for vsync and a heavy step does not hold the input nor the swap. Each completed step is
+// published through a triple buffer: the render thread draws the last one at its own rate.
+class Simulation {
+    public:
+        Simulation();
+        ~Simulation();
+
+        glm::vec3 centerBox = glm::vec3(0.0f);
+        float halfBox = 0.5f;
+        unsigned int n_substeps = 2;
+        float ccd_threshold = 0.5f;
+        float dt = 1.0f / 120.0f;
+        // Steps follow the wall clock, else they run as fast as they can
+        bool realtime = true;
+
+        // Called on a job with each completed state while the next step is computed
+        std::function<void(const SimState&)> onStep;
+
+        void start(const std::vector<Sphere>& spheres, double time);
+        // Returns once the step in progress is done
+        void stop();
+        bool running() const { return thread.joinable(); };
+
+        // Last published state, it stays valid until the next call. Render thread only.
+        const SimState& latest();
+        // Completed steps per second, measured over the last second
+        double stepRate() const { return rate; };
+        // Most bytes the transient data of a step took in the frame arena of the simulation thread
+        size_t arenaHighWater() const { return arena_high_water; };
+
+    private:
+        std::thread thread;
+        std::atomic<bool> quit;
+        std::atomic<double> rate;
+        std::atomic<size_t> arena_high_water;
+        TripleBuffer<SimState> states;
+
+        void run(SimState state);
+        void step(std::vector<Sphere>& spheres);
+};
+
+#endif
@@ -0,0 +1,143 @@
+#ifndef TRAJECTORY_HPP
+#define TRAJECTORY_HPP
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <glm/glm.hpp>
+
+#include "object.hpp"
+#include "async_writer.hpp"
+
+// Trajectory file layout, every block starts on a 4096 bytes boundary:
+//   header | static block (radius, color) | chunk | chunk | ... | chunk index
+// A chunk holds up to steps_per_chunk frames. A frame is columnar: time, then x[n], y[n], z[n]
+// and vx[n], vy[n], vz[n] when the schema has velocities. The header and the index are only
+// complete once the recorder is closed. With SCHEMA_COMPRESSED the chunks are coded, see codec.hpp.
+const uint32_t TRAJECTORY_BLOCK = 4096;
+const char TRAJECTORY_MAGIC[8] = {'P', 'H', 'Y', 'S', 'T', 'R', 'A', 'J'};
+const uint32_t TRAJECTORY_VERSION = 3;
+
+enum Trajectory_Schema {
+    SCHEMA_POS = 1,
+    SCHEMA_VEL = 2,
+    SCHEMA_COMPRESSED = 4
+};
+
+enum Chunk_Flags {
+    CHUNK_COMPRESSED = 1
+};
+
+struct TrajectoryHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t schema;            // Trajectory_Schema flags
+    uint64_t n_particles;
+    float dt;                   // nominal time between frames, the exact time is stored per frame
+    uint32_t steps_per_chunk;
+    uint64_t n_frames;
+    uint64_t n_chunks;
+    uint64_t static_offset;
+    uint64_t index_offset;
+
+    // SCHEMA_COMPRESSED: column c of a frame is stored as round((value - origin[c]) / step[c]),
+    // in segments of segment_particles particles coded independently
+    float origin[6];
+    float step[6];
+    uint32_t segment_particles;
+};
+
+// One entry of the chunk index
+struct ChunkInfo {
+    uint64_t offset;
+    uint64_t bytes;
+    uint64_t first_frame;
+    uint32_t n_frames;
+    uint32_t flags;
+};
+
+inline uint64_t alignBlock(uint64_t bytes) {
+    return (bytes + TRAJECTORY_BLOCK - 1) / TRAJECTORY_BLOCK * TRAJECTORY_BLOCK;
+}
+
+// Float columns of a frame, and bytes of one frame for n particles
+uint32_t frameColumns(uint32_t schema);
+uint64_t frameBytes(uint32_t schema, uint64_t n_particles);
+
+// An index entry of a file of file_bytes that readers can trust: its bytes are in the file, its
+// frames within [0, header.n_frames), and a raw chunk holds exactly its frames
+bool validChunk(const TrajectoryHeader& header, const ChunkInfo& info, uint64_t file_bytes);
+
+// Quantization of a compressed trajectory
+struct TrajectoryCodec {
+    glm::vec3 box_min = glm::vec3(-0.5f);
+    glm::vec3 box_max = glm::vec3(0.5f);
+    uint32_t position_bits = 16;        // steps across the box on each axis, error is half a step
+    float velocity_step = 0.0f;         // 0: position step / dt, as precise as the positions
+    uint32_t segment_particles = 16384;
+};
+
+// Appends the state of the spheres to a trajectory file.
+// record() only copies the state into the current chunk buffer, full chunks go to an AsyncWriter
+// (io_uring with O_DIRECT, or a pwrite thread pool) that keeps several chunk writes in flight;
+// record() only waits when the disk cannot keep up. With SCHEMA_COMPRESSED a background thread
+// codes the chunks before they are written, set codec before open().
+class TrajectoryRecorder {
+    public:
+        TrajectoryRecorder();
+        ~TrajectoryRecorder();
+
+        TrajectoryCodec codec;
+
+        // chunk_bytes is the target size of a chunk, at least one frame per chunk
+        bool open(const std::string& filename, const std::vector<Sphere>& spheres, float dt,
+                  uint32_t schema = SCHEMA_POS | SCHEMA_VEL, uint64_t chunk_bytes = 16 << 20);
+        void record(const std::vector<Sphere>& spheres, double time);
+        // Flushes the last chunk and writes the index and the final header
+        void close();
+
+        bool isOpen() const { return output.isOpen(); };
+        uint64_t frames() const { return header.n_frames; };
+        // Total time record() spent waiting for a free buffer, in seconds
+        double stallTime() const { return stall + output.metrics().stall; };
+        // Queue depth, bytes and stalls of the writes
+        AsyncWriterMetrics writerMetrics() const { return output.metrics(); };
+
+    private:
+        struct Buffer {
+            unsigned char* data = nullptr;
+            int output = -1;            // writer buffer holding the frames, raw schema only
+            uint64_t first_frame = 0;
+            uint32_t n_frames = 0;
+        };
+
+        AsyncWriter output;
+        TrajectoryHeader header;
+        uint64_t frame_bytes;
+        uint64_t offset;                // where the next chunk goes
+        double stall;
+        std::vector<ChunkInfo> index;
+
+        Buffer raw;
+        Buffer* current;
+
+        // SCHEMA_COMPRESSED: frames are gathered in these, then coded by the encoder thread
+        static const int N_BUFFERS = 3;
+        Buffer buffers[N_BUFFERS];
+        std::thread encoder;
+        std::mutex mutex;
+        std::condition_variable cv;
+        std::deque<Buffer*> pending, spare;     // chunks to code, buffers to fill
+        bool stop;
+
+        void submit();
+        void encode();
+        void writeChunk(int buffer, uint64_t bytes, const Buffer& frames, uint32_t flags);
+        void writeBlock(const void* data, uint64_t bytes, uint64_t at);
+};
+
+#endif
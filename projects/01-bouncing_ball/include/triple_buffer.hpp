@@ -0,0 +1,44 @@
+#ifndef TRIPLE_BUFFER_HPP
+#define TRIPLE_BUFFER_HPP
+
+#include <atomic>
+
+// One writer and one reader exchanging whole states without locks nor waits. The writer fills
+// its back slot and publishes it by swapping it with the middle slot, the reader swaps its front
+// slot with the middle one when a newer state is there. Neither ever touches the slot of the
+// other, and the reader always sees the last complete state, intermediate ones are skipped.
+template<typename T>
+class TripleBuffer {
+    public:
+        TripleBuffer(): front(0), back(2), middle(1) {};
+
+        // Sets the three slots, before the threads start
+        void reset(const T& value) {
+            for (int i = 0; i != 3; ++i)
+                slots[i] = value;
+        };
+
+        // Writer side
+        T& write() { return slots[back]; };
+        void publish() { back = middle.exchange(back | FRESH, std::memory_order_acq_rel) & INDEX; };
+
+        // Reader side: takes the last published state, false if there is none since the last call
+        bool update() {
+            if (!(middle.load(std::memory_order_relaxed) & FRESH))
+                return false;
+            front = middle.exchange(front, std::memory_order_acq_rel) & INDEX;
+            return true;
+        };
+        const T& read() const { return slots[front]; };
+
+    private:
+        static const unsigned int INDEX = 3;
+        static const unsigned int FRESH = 4;        // middle holds a state the reader has not seen
+
+        T slots[3];
+        unsigned int front;
+        unsigned int back;
+        std::atomic<unsigned int> middle;
+};
+
+#endif
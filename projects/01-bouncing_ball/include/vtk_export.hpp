@@ -0,0 +1,13 @@
+#ifndef VTK_EXPORT_HPP
+#define VTK_EXPORT_HPP
+
+#include <cstdint>
+#include <string>
+
+// Converts a trajectory recording for ParaView: one <prefix>_<frame>.vtp per exported step (poly
+// data, points with velocity, radius and color, appended raw binary) and <prefix>.pvd listing
+// them with their time. Chunks are exported in parallel. The points have no cells: show them
+// with the Point Gaussian representation.
+bool exportVTK(const std::string& trajectory, const std::string& prefix, uint64_t stride = 1);
+
+#endif
@@ -12,3 +12,9 @@ project "01-bouncing_ball"
     files "src/**"
 
     links { "GLAD", "GLFW", "GLM" }
+
+    -- shm_open lives in librt before glibc 2.34
+    filter "system:linux"
+        links { "rt" }
+
+    filter { }
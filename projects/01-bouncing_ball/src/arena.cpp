@@ -0,0 +1,74 @@
+#include <algorithm>
+#include <new>
+
+#include "arena.hpp"
+
+// Blocks are cache line aligned
+static const size_t BLOCK_ALIGN = 64;
+
+Arena::Arena(size_t block_bytes): current(0), offset(0), used_before(0), block_bytes(block_bytes), high_water(0), n_allocations(0) {
+    addBlock(block_bytes);
+};
+
+Arena::~Arena() {
+    for (std::vector<Block>::iterator it = blocks.begin(); it != blocks.end(); ++it)
+        ::operator delete(it->data, std::align_val_t(BLOCK_ALIGN));
+};
+
+void* Arena::allocate(size_t bytes, size_t align) {
+    size_t start = (offset + align - 1) & ~(align - 1);
+    while (start + bytes > blocks[current].bytes) {
+        // The tail of the block is left unused
+        used_before += blocks[current].bytes;
+        ++current;
+        if (current == blocks.size())
+            addBlock(std::max(bytes + align, blocks.back().bytes * 2));
+        start = 0;
+    }
+    offset = start + bytes;
+    high_water = std::max(high_water, used());
+    return blocks[current].data + start;
+};
+
+void Arena::rewind(Mark m) {
+    current = m.block;
+    offset = m.offset;
+    used_before = 0;
+    for (size_t i = 0; i != current; ++i)
+        used_before += blocks[i].bytes;
+};
+
+void Arena::reset() {
+    // Several blocks: replace them with one that holds them all, reused from now on
+    if (blocks.size() > 1) {
+        size_t bytes = capacity();
+        for (std::vector<Block>::iterator it = blocks.begin(); it != blocks.end(); ++it)
+            ::operator delete(it->data, std::align_val_t(BLOCK_ALIGN));
+        blocks.clear();
+        addBlock(bytes);
+    }
+    current = 0;
+    offset = 0;
+    used_before = 0;
+};
+
+size_t Arena::capacity() const {
+    size_t bytes = 0;
+    for (std::vector<Block>::const_iterator it = blocks.begin(); it != blocks.end(); ++it)
+        bytes += it->bytes;
+    return bytes;
+};
+
+void Arena::addBlock(size_t bytes) {
+    bytes = std::max<size_t>((bytes + BLOCK_ALIGN - 1) & ~(BLOCK_ALIGN - 1), BLOCK_ALIGN);
+    Block block;
+    block.data = (unsigned char*)::operator new(bytes, std::align_val_t(BLOCK_ALIGN));
+    block.bytes = bytes;
+    blocks.push_back(block);
+    ++n_allocations;
+};
+
+Arena& frameArena() {
+    static thread_local Arena arena;
+    return arena;
+};
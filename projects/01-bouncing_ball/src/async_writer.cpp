@@ -0,0 +1,367 @@
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "async_writer.hpp"
+
+// Mapped rings of an io_uring instance, driven through the raw syscalls
+struct AsyncWriter::Ring {
+    int fd = -1;
+    void* sq_map = nullptr;
+    size_t sq_bytes = 0;
+    void* cq_map = nullptr;
+    size_t cq_bytes = 0;
+    io_uring_sqe* sqes = nullptr;
+    size_t sqes_bytes = 0;
+
+    unsigned* sq_head;
+    unsigned* sq_tail;
+    unsigned* sq_mask;
+    unsigned* sq_array;
+    unsigned* cq_head;
+    unsigned* cq_tail;
+    unsigned* cq_mask;
+    io_uring_cqe* cqes;
+
+    unsigned pending = 0;               // queued but not yet entered
+};
+
+static int uringSetup(unsigned entries, io_uring_params* params) {
+    return (int)::syscall(__NR_io_uring_setup, entries, params);
+}
+
+static int uringEnter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags) {
+    return (int)::syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, nullptr, 0);
+}
+
+static int uringRegister(int fd, unsigned opcode, const void* arg, unsigned n) {
+    return (int)::syscall(__NR_io_uring_register, fd, opcode, arg, n);
+}
+
+
+AsyncWriter::AsyncWriter(): fd(-1), buffer_bytes(0), failed(false), ring(nullptr), stop(false) {};
+
+AsyncWriter::~AsyncWriter() {
+    close();
+};
+
+bool AsyncWriter::open(const std::string& filename, uint32_t n_buffers, uint64_t buffer_bytes, bool direct) {
+    close();
+
+    n_buffers = std::max<uint32_t>(n_buffers, 1);
+    buffer_bytes = (buffer_bytes + ASYNC_WRITER_ALIGN - 1) / ASYNC_WRITER_ALIGN * ASYNC_WRITER_ALIGN;
+    stats = AsyncWriterMetrics();
+
+    // O_DIRECT skips the page cache, tmpfs and a few others refuse it
+    fd = direct ? ::open(filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_DIRECT, 0644) : -1;
+    stats.direct = fd >= 0;
+    if (fd < 0)
+        fd = ::open(filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        std::cout << "ERROR::ASYNC_WRITER::FILE_NOT_SUCCESSFULLY_OPENED " << filename << std::endl;
+        return false;
+    }
+
+    this->buffer_bytes = buffer_bytes;
+    buffers.resize(n_buffers);
+    jobs.resize(n_buffers);
+    for (uint32_t i = 0; i != n_buffers; ++i) {
+        buffers[i] = (unsigned char*)std::aligned_alloc(ASYNC_WRITER_ALIGN, buffer_bytes);
+        free.push_back(i);
+    }
+    failed = false;
+    stop = false;
+
+    if (setupRing(n_buffers)) {
+        stats.backend = "io_uring";
+    } else {
+        stats.backend = "pwrite";
+        unsigned int n_threads = std::min<uint32_t>(n_buffers, 4);
+        for (unsigned int i = 0; i != n_threads; ++i)
+            pool.emplace_back(&AsyncWriter::work, this);
+    }
+    return true;
+};
+
+bool AsyncWriter::close() {
+    if (fd < 0)
+        return true;
+
+    bool ok = flush();
+    if (ring != nullptr) {
+        freeRing();
+    } else {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stop = true;
+        }
+        cv.notify_all();
+        for (std::vector<std::thread>::iterator it = pool.begin(); it != pool.end(); ++it)
+            it->join();
+        pool.clear();
+    }
+
+    ::close(fd);
+    fd = -1;
+    for (std::vector<unsigned char*>::iterator it = buffers.begin(); it != buffers.end(); ++it)
+        std::free(*it);
+    buffers.clear();
+    jobs.clear();
+    queue.clear();
+    free.clear();
+    return ok;
+};
+
+bool AsyncWriter::setupRing(uint32_t entries) {
+    io_uring_params params;
+    std::memset(&params, 0, sizeof(params));
+    int ring_fd = uringSetup(entries, &params);
+    if (ring_fd < 0)
+        return false;
+
+    ring = new Ring();
+    ring->fd = ring_fd;
+    ring->sq_bytes = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    ring->cq_bytes = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    if (params.features & IORING_FEAT_SINGLE_MMAP)
+        ring->sq_bytes = ring->cq_bytes = std::max(ring->sq_bytes, ring->cq_bytes);
+
+    ring->sq_map = ::mmap(nullptr, ring->sq_bytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQ_RING);
+    if (ring->sq_map == MAP_FAILED) {
+        ring->sq_map = nullptr;
+        freeRing();
+        return false;
+    }
+    if (params.features & IORING_FEAT_SINGLE_MMAP) {
+        ring->cq_map = ring->sq_map;
+    } else {
+        ring->cq_map = ::mmap(nullptr, ring->cq_bytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_CQ_RING);
+        if (ring->cq_map == MAP_FAILED) {
+            ring->cq_map = nullptr;
+            freeRing();
+            return false;
+        }
+    }
+    ring->sqes_bytes = params.sq_entries * sizeof(io_uring_sqe);
+    void* sqes = ::mmap(nullptr, ring->sqes_bytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQES);
+    if (sqes == MAP_FAILED) {
+        freeRing();
+        return false;
+    }
+    ring->sqes = (io_uring_sqe*)sqes;
+
+    char* sq = (char*)ring->sq_map;
+    char* cq = (char*)ring->cq_map;
+    ring->sq_head = (unsigned*)(sq + params.sq_off.head);
+    ring->sq_tail = (unsigned*)(sq + params.sq_off.tail);
+    ring->sq_mask = (unsigned*)(sq + params.sq_off.ring_mask);
+    ring->sq_array = (unsigned*)(sq + params.sq_off.array);
+    ring->cq_head = (unsigned*)(cq + params.cq_off.head);
+    ring->cq_tail = (unsigned*)(cq + params.cq_off.tail);
+    ring->cq_mask = (unsigned*)(cq + params.cq_off.ring_mask);
+    ring->cqes = (io_uring_cqe*)(cq + params.cq_off.cqes);
+
+    // Registered buffers are pinned once instead of mapped on every write
+    std::vector<iovec> iovecs(buffers.size());
+    for (size_t i = 0; i != buffers.size(); ++i) {
+        iovecs[i].iov_base = buffers[i];
+        iovecs[i].iov_len = buffer_bytes;
+    }
+    if (uringRegister(ring_fd, IORING_REGISTER_BUFFERS, iovecs.data(), (unsigned)iovecs.size()) < 0) {
+        freeRing();
+        return false;
+    }
+    return true;
+};
+
+void AsyncWriter::freeRing() {
+    if (ring == nullptr)
+        return;
+    if (ring->sqes != nullptr)
+        ::munmap(ring->sqes, ring->sqes_bytes);
+    if (ring->cq_map != nullptr && ring->cq_map != ring->sq_map)
+        ::munmap(ring->cq_map, ring->cq_bytes);
+    if (ring->sq_map != nullptr)
+        ::munmap(ring->sq_map, ring->sq_bytes);
+    if (ring->fd >= 0)
+        ::close(ring->fd);
+    delete ring;
+    ring = nullptr;
+};
+
+void AsyncWriter::pushRing(int buffer) {
+    // There are as many entries as buffers: a free entry always exists
+    const Job& job = jobs[buffer];
+    unsigned tail = *ring->sq_tail;
+    unsigned index = tail & *ring->sq_mask;
+    io_uring_sqe& sqe = ring->sqes[index];
+    std::memset(&sqe, 0, sizeof(sqe));
+    sqe.opcode = IORING_OP_WRITE_FIXED;
+    sqe.fd = fd;
+    sqe.off = job.offset + job.written;
+    sqe.addr = (uint64_t)(buffers[buffer] + job.written);
+    sqe.len = (uint32_t)(job.bytes - job.written);
+    sqe.buf_index = (uint16_t)buffer;
+    sqe.user_data = (uint64_t)buffer;
+    ring->sq_array[index] = index;
+    __atomic_store_n(ring->sq_tail, tail + 1, __ATOMIC_RELEASE);
+    ++ring->pending;
+};
+
+// Submits what is queued and handles the completions there are, waits for one when wait is set
+bool AsyncWriter::reap(bool wait) {
+    if (ring->pending != 0 || wait) {
+        int n = uringEnter(ring->fd, ring->pending, wait ? 1 : 0, wait ? IORING_ENTER_GETEVENTS : 0);
+        if (n < 0 && errno != EINTR && errno != EAGAIN && errno != EBUSY) {
+            std::cout << "ERROR::ASYNC_WRITER::IO_URING_ENTER " << std::strerror(errno) << std::endl;
+            return false;
+        }
+        if (n > 0)
+            ring->pending -= std::min<unsigned>(ring->pending, n);
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    unsigned head = *ring->cq_head;
+    unsigned tail = __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE);
+    for (; head != tail; ++head) {
+        const io_uring_cqe& cqe = ring->cqes[head & *ring->cq_mask];
+        int buffer = (int)cqe.user_data;
+        Job& job = jobs[buffer];
+        if (cqe.res > 0)
+            job.written += cqe.res;
+        if (cqe.res > 0 && job.written < job.bytes) {
+            // Short write: the rest goes again
+            pushRing(buffer);
+            continue;
+        }
+        done(buffer, cqe.res > 0 || job.bytes == 0);
+    }
+    __atomic_store_n(ring->cq_head, head, __ATOMIC_RELEASE);
+    return true;
+};
+
+// With the mutex held
+void AsyncWriter::done(int buffer, bool ok) {
+    if (!ok && !failed) {
+        std::cout << "ERROR::ASYNC_WRITER::WRITE_FAILED" << std::endl;
+        failed = true;
+    }
+    stats.bytes += jobs[buffer].written;
+    --stats.in_flight;
+    free.push_back(buffer);
+};
+
+int AsyncWriter::acquire() {
+    if (ring != nullptr)
+        reap(false);
+
+    std::unique_lock<std::mutex> lock(mutex);
+    if (free.empty()) {
+        auto start = std::chrono::steady_clock::now();
+        if (ring != nullptr) {
+            // Only this thread reaps: nothing frees a buffer while it waits
+            bool ok = true;
+            while (free.empty() && ok) {
+                lock.unlock();
+                ok = reap(true);
+                lock.lock();
+            }
+            if (free.empty()) {
+                // The ring broke down: take the buffers back, the data is lost
+                failed = true;
+                stats.in_flight = 0;
+                for (size_t i = 0; i != buffers.size(); ++i)
+                    free.push_back(i);
+            }
+        } else {
+            cv.wait(lock, [&]() { return !free.empty(); });
+        }
+        stats.stall += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+    int buffer = free.front();
+    free.pop_front();
+    return buffer;
+};
+
+void AsyncWriter::release(int buffer) {
+    std::lock_guard<std::mutex> lock(mutex);
+    free.push_back(buffer);
+    cv.notify_all();
+};
+
+void AsyncWriter::submit(int buffer, uint64_t bytes, uint64_t offset) {
+    Job job = {bytes, offset, 0};
+    std::unique_lock<std::mutex> lock(mutex);
+    jobs[buffer] = job;
+    ++stats.writes;
+    ++stats.in_flight;
+    stats.max_in_flight = std::max(stats.max_in_flight, stats.in_flight);
+    if (ring != nullptr) {
+        pushRing(buffer);
+        lock.unlock();
+        reap(false);
+    } else {
+        queue.push_back(buffer);
+        cv.notify_all();
+    }
+};
+
+bool AsyncWriter::flush() {
+    if (fd < 0)
+        return true;
+    if (ring != nullptr) {
+        while (metrics().in_flight != 0 && reap(true)) {}
+    } else {
+        std::unique_lock<std::mutex> lock(mutex);
+        cv.wait(lock, [&]() { return stats.in_flight == 0; });
+    }
+    return !failed;
+};
+
+AsyncWriterMetrics AsyncWriter::metrics() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return stats;
+};
+
+void AsyncWriter::work() {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        cv.wait(lock, [&]() { return stop || !queue.empty(); });
+        if (queue.empty())
+            return;
+        int buffer = queue.front();
+        queue.pop_front();
+        Job job = jobs[buffer];
+        lock.unlock();
+
+        const unsigned char* p = buffers[buffer];
+        bool ok = true;
+        while (job.written != job.bytes) {
+            ssize_t n = ::pwrite(fd, p + job.written, job.bytes - job.written, job.offset + job.written);
+            if (n < 0 && errno == EINTR)
+                continue;
+            if (n <= 0) {
+                ok = false;
+                break;
+            }
+            job.written += n;
+        }
+
+        lock.lock();
+        jobs[buffer] = job;
+        done(buffer, ok);
+        cv.notify_all();
+    }
+};
@@ -0,0 +1,149 @@
+#include <glm/glm.hpp>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "checkpoint.hpp"
+
+static const char CHECKPOINT_MAGIC[8] = {'P', 'H', 'Y', 'S', 'C', 'K', 'P', 'T'};
+static const uint32_t CHECKPOINT_VERSION = 1;
+
+
+Checkpoint makeCheckpoint(uint64_t n_spheres, double time, uint32_t seed, uint32_t n_substeps) {
+    Checkpoint header = Checkpoint();
+    std::memcpy(header.magic, CHECKPOINT_MAGIC, sizeof(header.magic));
+    header.version = CHECKPOINT_VERSION;
+    header.sphere_size = sizeof(Sphere);
+    header.n_spheres = n_spheres;
+    header.time = time;
+    header.seed = seed;
+    header.n_substeps = n_substeps;
+    return header;
+}
+
+static bool writeAll(int fd, const void* data, size_t bytes) {
+    const char* p = (const char*)data;
+    while (bytes != 0) {
+        ssize_t n = ::write(fd, p, bytes);
+        if (n <= 0)
+            return false;
+        p += n;
+        bytes -= n;
+    }
+    return true;
+}
+
+bool saveCheckpoint(const std::string& filename, const Checkpoint& header, const std::vector<Sphere>& spheres) {
+    std::string tmp = filename + ".tmp";
+    int fd = ::open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        std::cout << "ERROR::CHECKPOINT::FILE_NOT_SUCCESSFULLY_OPENED " << tmp << std::endl;
+        return false;
+    }
+
+    Checkpoint h = header;
+    h.n_spheres = spheres.size();
+    bool ok = writeAll(fd, &h, sizeof(h)) && writeAll(fd, spheres.data(), spheres.size() * sizeof(Sphere));
+    ok = (::fsync(fd) == 0) && ok;
+    ::close(fd);
+
+    if (!ok || std::rename(tmp.c_str(), filename.c_str()) != 0) {
+        std::cout << "ERROR::CHECKPOINT::WRITE_FAILED " << filename << std::endl;
+        std::remove(tmp.c_str());
+        return false;
+    }
+    return true;
+}
+
+bool loadCheckpoint(const std::string& filename, Checkpoint& header, std::vector<Sphere>& spheres) {
+    int fd = ::open(filename.c_str(), O_RDONLY);
+    if (fd < 0) {
+        std::cout << "ERROR::CHECKPOINT::FILE_NOT_SUCCESSFULLY_OPENED " << filename << std::endl;
+        return false;
+    }
+    struct stat st;
+    if (::fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(Checkpoint)) {
+        std::cout << "ERROR::CHECKPOINT::TRUNCATED " << filename << std::endl;
+        ::close(fd);
+        return false;
+    }
+
+    // Map the whole file: pages come straight from the page cache, no read() copies
+    void* data = ::mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (data == MAP_FAILED) {
+        std::cout << "ERROR::CHECKPOINT::MMAP_FAILED " << filename << std::endl;
+        return false;
+    }
+    ::madvise(data, st.st_size, MADV_SEQUENTIAL);
+
+    bool ok = false;
+    std::memcpy(&header, data, sizeof(header));
+    if (std::memcmp(header.magic, CHECKPOINT_MAGIC, sizeof(header.magic)) != 0 || header.version != CHECKPOINT_VERSION) {
+        std::cout << "ERROR::CHECKPOINT::NOT_A_CHECKPOINT " << filename << std::endl;
+    } else if (header.sphere_size != sizeof(Sphere)) {
+        std::cout << "ERROR::CHECKPOINT::INCOMPATIBLE_LAYOUT " << filename << std::endl;
+    } else if ((size_t)st.st_size < sizeof(header) + header.n_spheres * sizeof(Sphere)) {
+        std::cout << "ERROR::CHECKPOINT::TRUNCATED " << filename << std::endl;
+    } else {
+        const Sphere* first = (const Sphere*)((const char*)data + sizeof(header));
+        spheres.assign(first, first + header.n_spheres);
+        ok = true;
+    }
+
+    ::munmap(data, st.st_size);
+    return ok;
+}
+
+
+Autosave::Autosave(const std::string& filename, double interval): filename(filename), interval(interval), last(0.0), busy(false), stop(false) {
+    writer = std::thread(&Autosave::write, this);
+};
+
+Autosave::~Autosave() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stop = true;
+    }
+    cv.notify_all();
+    writer.join();
+};
+
+void Autosave::update(const Checkpoint& header, const std::vector<Sphere>& spheres) {
+    if (header.time - last < interval)
+        return;
+
+    std::unique_lock<std::mutex> lock(mutex);
+    // Previous save still running: try again next frame
+    if (busy)
+        return;
+    this->header = header;
+    snapshot.assign(spheres.begin(), spheres.end());
+    last = header.time;
+    busy = true;
+    lock.unlock();
+    cv.notify_all();
+};
+
+void Autosave::write() {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        cv.wait(lock, [&]() { return stop || busy; });
+        if (!busy)
+            return;
+
+        // The snapshot is only touched by update() when busy is false
+        lock.unlock();
+        saveCheckpoint(filename, header, snapshot);
+        lock.lock();
+        busy = false;
+    }
+};
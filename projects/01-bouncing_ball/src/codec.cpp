@@ -0,0 +1,380 @@
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+#include "codec.hpp"
+#include "parallel.hpp"
+
+// Bit length of a zigzag delta: 0 (delta 0) to 32
+static const uint32_t N_TOKENS = 33;
+
+// rANS with 32 bits state and byte renormalization, probabilities on 12 bits
+static const uint32_t PROB_BITS = 12;
+static const uint32_t PROB_SCALE = 1u << PROB_BITS;
+static const uint32_t RANS_L = 1u << 23;
+
+// Quantized values stay in [-2^30, 2^30] so that deltas fit in 32 bits
+static const double QUANT_LIMIT = (double)((1 << 30) - 1);
+
+struct SegmentHeader {
+    uint32_t rans_bytes;
+    uint32_t n_words;
+    uint16_t freq[N_TOKENS];
+    uint16_t orders;            // predictor of each column, 2 bits each from column 0 (version 3)
+};
+
+// Highest order of the extrapolation from the previous frames
+static const uint32_t MAX_ORDER = 3;
+
+
+static inline int32_t quantize(float x, float origin, float inv_step) {
+    double q = std::floor(((double)x - origin) * inv_step + 0.5);
+    if (!(q > -QUANT_LIMIT))        // NaN too
+        return q < 0.0 ? (int32_t)-QUANT_LIMIT : 0;
+    return (int32_t)std::min(q, QUANT_LIMIT);
+}
+
+static inline uint32_t zigzag(int32_t q, int32_t prev) {
+    int32_t d = (int32_t)((uint32_t)q - (uint32_t)prev);
+    return ((uint32_t)d << 1) ^ (uint32_t)(d >> 31);
+}
+
+static inline int32_t unzigzag(uint32_t v, int32_t prev) {
+    return (int32_t)((uint32_t)prev + ((v >> 1) ^ (0u - (v & 1))));
+}
+
+static inline uint32_t bitLength(uint32_t v) {
+    return v == 0 ? 0 : 32 - __builtin_clz(v);
+}
+
+// Prediction of the value q of a column from the same value in the previous frames, stride values
+// before each other: order 1 is the previous value (delta coding), 2 extrapolates the last
+// difference (constant velocity), 3 the last second difference (constant acceleration, free fall).
+// Wrapping arithmetic, the residual is taken modulo 2^32 as well.
+static inline int32_t extrapolate(const int32_t* q, uint64_t stride, uint32_t order) {
+    if (order == 0)
+        return 0;
+    uint32_t q1 = q[-(int64_t)stride];
+    if (order == 1)
+        return (int32_t)q1;
+    uint32_t q2 = q[-2 * (int64_t)stride];
+    if (order == 2)
+        return (int32_t)(2 * q1 - q2);
+    uint32_t q3 = q[-3 * (int64_t)stride];
+    return (int32_t)(3 * q1 - 3 * q2 + q3);
+}
+
+// The first frames of a chunk have fewer previous ones, the first is coded against zero
+static inline uint32_t columnOrder(uint16_t orders, uint32_t column, uint32_t frame) {
+    return std::min((uint32_t)(orders >> (2 * column)) & 3, frame);
+}
+
+
+// Scales the token counts to PROB_SCALE, every token that occurs keeps at least 1
+static void normalize(const uint64_t* counts, uint16_t* freq) {
+    uint64_t total = 0;
+    for (uint32_t s = 0; s != N_TOKENS; ++s)
+        total += counts[s];
+
+    int32_t sum = 0;
+    uint32_t largest = 0;
+    for (uint32_t s = 0; s != N_TOKENS; ++s) {
+        freq[s] = counts[s] == 0 ? 0 : (uint16_t)std::max<uint64_t>(1, counts[s] * PROB_SCALE / total);
+        sum += freq[s];
+        if (counts[s] > counts[largest])
+            largest = s;
+    }
+    // The rounding error goes to the most frequent token, which is at least PROB_SCALE / N_TOKENS
+    freq[largest] = (uint16_t)(freq[largest] + (int32_t)PROB_SCALE - sum);
+}
+
+static uint64_t encodeSegment(const TrajectoryHeader& header, const unsigned char* frames, uint32_t n_frames,
+                              uint64_t first, uint64_t last, std::vector<unsigned char>& out) {
+    uint64_t n = header.n_particles;
+    uint64_t m = last - first;
+    uint32_t columns = frameColumns(header.schema);
+    uint64_t frame_bytes = frameBytes(header.schema, n);
+    uint64_t n_values = (uint64_t)n_frames * columns * m;
+
+    // Quantized values in coding order: frame, column, particle
+    std::vector<int32_t> values(n_values);
+    uint64_t stride = (uint64_t)columns * m;
+    for (uint32_t f = 0; f != n_frames; ++f) {
+        const float* column = (const float*)(frames + f * frame_bytes + sizeof(double));
+        for (uint32_t c = 0; c != columns; ++c) {
+            const float* x = column + c * n + first;
+            int32_t* q = values.data() + f * stride + c * m;
+            float origin = header.origin[c];
+            float inv_step = 1.0f / header.step[c];
+            for (uint64_t i = 0; i != m; ++i)
+                q[i] = quantize(x[i], origin, inv_step);
+        }
+    }
+
+    // Each column takes the predictor with the shortest residuals over the segment: order 1 for
+    // colliding balls, higher orders when they fly freely. Version 2 only knows delta coding.
+    SegmentHeader segment = {};
+    for (uint32_t c = 0; c != columns; ++c) {
+        uint32_t best = 1;
+        if (header.version >= 3) {
+            uint64_t cost[MAX_ORDER + 1] = {0};
+            for (uint32_t f = 1; f != n_frames; ++f) {
+                const int32_t* q = values.data() + f * stride + c * m;
+                for (uint64_t i = 0; i != m; ++i) {
+                    for (uint32_t order = 1; order <= MAX_ORDER; ++order)
+                        cost[order] += bitLength(zigzag(q[i], extrapolate(q + i, stride, std::min(order, f))));
+                }
+            }
+            for (uint32_t order = 2; order <= MAX_ORDER; ++order) {
+                if (cost[order] < cost[best])
+                    best = order;
+            }
+        }
+        segment.orders |= (uint16_t)(best << (2 * c));
+    }
+
+    // Tokens, raw bits and statistics
+    std::vector<uint8_t> tokens(n_values);
+    std::vector<uint32_t> words;
+    words.reserve(n_values / 2 + 1);
+    uint64_t acc = 0;
+    uint32_t n_bits = 0;
+    uint64_t counts[N_TOKENS] = {0};
+
+    uint64_t k = 0;
+    for (uint32_t f = 0; f != n_frames; ++f) {
+        for (uint32_t c = 0; c != columns; ++c) {
+            uint32_t order = columnOrder(segment.orders, c, f);
+            for (uint64_t i = 0; i != m; ++i, ++k) {
+                uint32_t v = zigzag(values[k], extrapolate(&values[k], stride, order));
+
+                uint32_t t = bitLength(v);
+                tokens[k] = (uint8_t)t;
+                ++counts[t];
+                // The leading 1 is implied by the length
+                if (t > 1) {
+                    acc |= (uint64_t)(v & ((1u << (t - 1)) - 1)) << n_bits;
+                    n_bits += t - 1;
+                    if (n_bits >= 32) {
+                        words.push_back((uint32_t)acc);
+                        acc >>= 32;
+                        n_bits -= 32;
+                    }
+                }
+            }
+        }
+    }
+    if (n_bits != 0)
+        words.push_back((uint32_t)acc);
+
+    normalize(counts, segment.freq);
+    uint32_t start[N_TOKENS];
+    for (uint32_t s = 0, sum = 0; s != N_TOKENS; sum += segment.freq[s], ++s)
+        start[s] = sum;
+
+    // Second pass: rANS runs backwards so that the decoder reads forwards
+    std::vector<unsigned char> rans(2 * n_values + 8);
+    unsigned char* end = rans.data() + rans.size();
+    unsigned char* ptr = end;
+    uint32_t x = RANS_L;
+    for (uint64_t j = n_values; j-- > 0;) {
+        uint32_t s = tokens[j];
+        uint32_t freq = segment.freq[s];
+        uint32_t x_max = ((RANS_L >> PROB_BITS) << 8) * freq;
+        while (x >= x_max) {
+            *--ptr = (unsigned char)(x & 0xff);
+            x >>= 8;
+        }
+        x = ((x / freq) << PROB_BITS) + (x % freq) + start[s];
+    }
+    ptr -= 4;
+    std::memcpy(ptr, &x, sizeof(x));
+
+    segment.rans_bytes = (uint32_t)(end - ptr);
+    segment.n_words = (uint32_t)words.size();
+    out.resize(sizeof(segment) + segment.rans_bytes + words.size() * sizeof(uint32_t));
+    std::memcpy(out.data(), &segment, sizeof(segment));
+    std::memcpy(out.data() + sizeof(segment), ptr, segment.rans_bytes);
+    std::memcpy(out.data() + sizeof(segment) + segment.rans_bytes, words.data(), words.size() * sizeof(uint32_t));
+    return out.size();
+}
+
+static bool decodeSegment(const TrajectoryHeader& header, const unsigned char* data, uint64_t bytes, uint32_t n_frames,
+                          uint64_t first, uint64_t last, unsigned char* frames) {
+    SegmentHeader segment;
+    if (bytes < sizeof(segment))
+        return false;
+    std::memcpy(&segment, data, sizeof(segment));
+    if (bytes < sizeof(segment) + (uint64_t)segment.rans_bytes + (uint64_t)segment.n_words * sizeof(uint32_t) || segment.rans_bytes < 4)
+        return false;
+
+    uint32_t start[N_TOKENS];
+    uint8_t lookup[PROB_SCALE];
+    uint32_t sum = 0;
+    for (uint32_t s = 0; s != N_TOKENS; ++s) {
+        start[s] = sum;
+        if (sum + segment.freq[s] > PROB_SCALE)
+            return false;
+        std::memset(lookup + sum, (int)s, segment.freq[s]);
+        sum += segment.freq[s];
+    }
+    if (sum != PROB_SCALE)
+        return false;
+
+    const unsigned char* ptr = data + sizeof(segment);
+    const unsigned char* rans_end = ptr + segment.rans_bytes;
+    const unsigned char* words = rans_end;
+    const unsigned char* words_end = words + segment.n_words * sizeof(uint32_t);
+    uint32_t x;
+    std::memcpy(&x, ptr, sizeof(x));
+    ptr += 4;
+    uint64_t acc = 0;
+    uint32_t n_bits = 0;
+
+    uint64_t n = header.n_particles;
+    uint64_t m = last - first;
+    uint32_t columns = frameColumns(header.schema);
+    uint64_t frame_bytes = frameBytes(header.schema, n);
+
+    uint16_t orders = header.version >= 3 ? segment.orders : 0x0555;
+    std::vector<int32_t> values((uint64_t)n_frames * columns * m);
+    uint64_t stride = (uint64_t)columns * m;
+    uint64_t k = 0;
+    for (uint32_t f = 0; f != n_frames; ++f) {
+        float* column = (float*)(frames + f * frame_bytes + sizeof(double));
+        for (uint32_t c = 0; c != columns; ++c) {
+            float* y = column + c * n + first;
+            uint32_t order = columnOrder(orders, c, f);
+            float origin = header.origin[c];
+            float step = header.step[c];
+            for (uint64_t i = 0; i != m; ++i, ++k) {
+                uint32_t slot = x & (PROB_SCALE - 1);
+                uint32_t t = lookup[slot];
+                x = segment.freq[t] * (x >> PROB_BITS) + slot - start[t];
+                while (x < RANS_L && ptr != rans_end)
+                    x = (x << 8) | *ptr++;
+
+                uint32_t v = t == 0 ? 0 : 1u << (t - 1);
+                if (t > 1) {
+                    if (n_bits < t - 1) {
+                        if (words == words_end)
+                            return false;
+                        uint32_t word;
+                        std::memcpy(&word, words, sizeof(word));
+                        words += sizeof(word);
+                        acc |= (uint64_t)word << n_bits;
+                        n_bits += 32;
+                    }
+                    v |= (uint32_t)acc & ((1u << (t - 1)) - 1);
+                    acc >>= t - 1;
+                    n_bits -= t - 1;
+                }
+
+                values[k] = unzigzag(v, extrapolate(&values[k], stride, order));
+                y[i] = origin + (float)values[k] * step;
+            }
+        }
+    }
+    return true;
+}
+
+
+void setupCodec(TrajectoryHeader& header, const TrajectoryCodec& codec) {
+    uint32_t bits = std::min<uint32_t>(std::max<uint32_t>(codec.position_bits, 1), 30);
+    float position_step[3];
+    for (int axis = 0; axis != 3; ++axis)
+        position_step[axis] = std::max((codec.box_max[axis] - codec.box_min[axis]) / (float)((1u << bits) - 1), 1e-12f);
+
+    // By default a velocity is as precise as the positions: its error moves a ball by at most half
+    // a position step over one frame. Finer steps only code the collision noise of the velocities.
+    float velocity_step = codec.velocity_step;
+    if (!(velocity_step > 0.0f))
+        velocity_step = header.dt > 0.0f ? *std::min_element(position_step, position_step + 3) / header.dt : 1e-4f;
+
+    uint32_t c = 0;
+    if (header.schema & SCHEMA_POS) {
+        for (int axis = 0; axis != 3; ++axis, ++c) {
+            header.origin[c] = codec.box_min[axis];
+            header.step[c] = position_step[axis];
+        }
+    }
+    if (header.schema & SCHEMA_VEL) {
+        for (int axis = 0; axis != 3; ++axis, ++c) {
+            header.origin[c] = 0.0f;
+            header.step[c] = std::max(velocity_step, 1e-12f);
+        }
+    }
+    header.segment_particles = std::max<uint32_t>(codec.segment_particles, 1);
+}
+
+uint64_t compressedBound(const TrajectoryHeader& header, uint32_t n_frames) {
+    uint64_t n = header.n_particles;
+    uint64_t n_segments = (n + header.segment_particles - 1) / header.segment_particles;
+    uint64_t n_values = (uint64_t)n_frames * frameColumns(header.schema) * n;
+    // rANS: at most PROB_BITS bits per token, raw bits: at most 31 per value
+    return n_frames * sizeof(double) + n_segments * (sizeof(uint64_t) + sizeof(SegmentHeader) + 12) + n_values * 6;
+}
+
+uint64_t encodeChunk(const TrajectoryHeader& header, const unsigned char* frames, uint32_t n_frames, unsigned char* out) {
+    uint64_t n = header.n_particles;
+    uint64_t frame_bytes = frameBytes(header.schema, n);
+    uint64_t n_segments = (n + header.segment_particles - 1) / header.segment_particles;
+
+    unsigned char* p = out;
+    for (uint32_t f = 0; f != n_frames; ++f, p += sizeof(double))
+        std::memcpy(p, frames + f * frame_bytes, sizeof(double));
+    unsigned char* table = p;
+    p += n_segments * sizeof(uint64_t);
+
+    std::vector<std::vector<unsigned char> > coded(n_segments);
+    parallel_for(0, n_segments, 1, [&](size_t begin, size_t end) {
+        for (size_t s = begin; s != end; ++s) {
+            uint64_t first = s * header.segment_particles;
+            encodeSegment(header, frames, n_frames, first, std::min(first + header.segment_particles, n), coded[s]);
+        }
+    });
+
+    for (uint64_t s = 0; s != n_segments; ++s) {
+        std::memcpy(p, coded[s].data(), coded[s].size());
+        p += coded[s].size();
+        uint64_t segment_end = p - out;
+        std::memcpy(table + s * sizeof(uint64_t), &segment_end, sizeof(segment_end));
+    }
+    return p - out;
+}
+
+bool decodeChunk(const TrajectoryHeader& header, const unsigned char* data, uint64_t bytes, uint32_t n_frames, unsigned char* frames) {
+    uint64_t n = header.n_particles;
+    uint64_t frame_bytes = frameBytes(header.schema, n);
+    uint64_t n_segments = (n + header.segment_particles - 1) / header.segment_particles;
+    uint64_t table = n_frames * sizeof(double);
+    uint64_t begin = table + n_segments * sizeof(uint64_t);
+    if (bytes < begin)
+        return false;
+
+    for (uint32_t f = 0; f != n_frames; ++f)
+        std::memcpy(frames + f * frame_bytes, data + f * sizeof(double), sizeof(double));
+
+    std::vector<uint64_t> ends(n_segments);
+    std::memcpy(ends.data(), data + table, n_segments * sizeof(uint64_t));
+    for (uint64_t s = 0, previous = begin; s != n_segments; previous = ends[s], ++s) {
+        if (ends[s] < previous || ends[s] > bytes)
+            return false;
+    }
+
+    std::atomic<bool> ok(true);
+    parallel_for(0, n_segments, 1, [&](size_t first_segment, size_t last_segment) {
+        for (size_t s = first_segment; s != last_segment; ++s) {
+            uint64_t from = s == 0 ? begin : ends[s - 1];
+            uint64_t first = s * header.segment_particles;
+            if (!decodeSegment(header, data + from, ends[s] - from, n_frames, first,
+                               std::min(first + header.segment_particles, n), frames))
+                ok = false;
+        }
+    });
+    return ok;
+}
@@ -0,0 +1,117 @@
+#include <glm/glm.hpp>
+
+#include <cmath>
+#include <iostream>
+#include <vector>
+
+#include "diagnostics.hpp"
+#include "parallel.hpp"
+#include "physics.hpp"
+#include "arena.hpp"
+
+// Particles per reduction chunk
+static const size_t GRAIN = 65536;
+
+// Compensated (Kahan) accumulator
+struct KahanSum {
+    double sum = 0.0;
+    double c = 0.0;
+
+    void add(double x) {
+        double y = x - c;
+        double t = sum + y;
+        c = (t - sum) - y;
+        sum = t;
+    };
+};
+
+struct Partial {
+    double kinetic, potential;
+    glm::dvec3 momentum;
+};
+
+// Add partials [begin, end) pairwise: rounding error grows with log(n) instead of n
+static Partial pairwise(const Partial* partials, size_t begin, size_t end) {
+    if (end - begin == 1)
+        return partials[begin];
+
+    size_t mid = begin + (end - begin) / 2;
+    Partial a = pairwise(partials, begin, mid);
+    Partial b = pairwise(partials, mid, end);
+    return {a.kinetic + b.kinetic, a.potential + b.potential, a.momentum + b.momentum};
+}
+
+
+EnergyMonitor::EnergyMonitor(unsigned int every, double threshold): every(every), threshold(threshold), onDrift(printEnergyStats) {
+    reset();
+};
+
+void EnergyMonitor::reset() {
+    n_steps = 0;
+    alerted = false;
+    current = EnergyStats();
+};
+
+bool EnergyMonitor::update(const std::vector<Sphere>& spheres) {
+    if (every == 0 || n_steps++ % every != 0 || spheres.empty())
+        return false;
+
+    // Fixed chunking: the same particles always land in the same partial
+    size_t n_chunks = (spheres.size() + GRAIN - 1) / GRAIN;
+    Arena& arena = frameArena();
+    ArenaScope scope(arena);
+    Partial* partials = (Partial*)arena.allocate(n_chunks * sizeof(Partial), alignof(Partial));
+
+    parallel_for(0, n_chunks, 1, [&](size_t begin, size_t end) {
+        for (size_t chunk = begin; chunk != end; ++chunk) {
+            KahanSum kinetic, potential, px, py, pz;
+            size_t last = std::min(spheres.size(), (chunk + 1) * GRAIN);
+            for (size_t i = chunk * GRAIN; i != last; ++i) {
+                const Sphere& s = spheres[i];
+                // The terms of energy() in double, its float result would round them
+                double k, u;
+                energyTerms(s, k, u);
+                kinetic.add(k);
+                potential.add(u);
+                double m = s.m;
+                glm::dvec3 v(s.vel);
+                px.add(m * v.x);
+                py.add(m * v.y);
+                pz.add(m * v.z);
+            }
+            partials[chunk] = {kinetic.sum, potential.sum, glm::dvec3(px.sum, py.sum, pz.sum)};
+        }
+    });
+
+    Partial total = pairwise(partials, 0, n_chunks);
+    current.kinetic = total.kinetic;
+    current.potential = total.potential;
+    current.total = total.kinetic + total.potential;
+    current.momentum = total.momentum;
+
+    if (current.n_samples == 0) {
+        current.initial = current.min = current.max = current.total;
+    } else {
+        current.min = std::min(current.min, current.total);
+        current.max = std::max(current.max, current.total);
+    }
+    ++current.n_samples;
+
+    double ref = std::abs(current.initial);
+    current.drift = ref > 0.0 ? (current.total - current.initial) / ref : 0.0;
+
+    bool over = std::abs(current.drift) > threshold;
+    if (over && !alerted && onDrift)
+        onDrift(current);
+    alerted = over;
+
+    return true;
+};
+
+void printEnergyStats(const EnergyStats& stats) {
+    std::cout << "\nWARNING::ENERGY::DRIFT " << stats.drift * 100.0 << "%"
+              << " E=" << stats.total << " (K=" << stats.kinetic << ", U=" << stats.potential << ")"
+              << " E0=" << stats.initial << " min=" << stats.min << " max=" << stats.max
+              << " p=(" << stats.momentum.x << ", " << stats.momentum.y << ", " << stats.momentum.z << ")"
+              << " samples=" << stats.n_samples << std::endl;
+};
@@ -5,8 +5,10 @@
 #include <glm/gtc/type_ptr.hpp>
 #include <glm/gtc/random.hpp>
 
+#include <cstdlib>
 #include <filesystem>
 #include <iostream>
+#include <memory>
 #include <string.h>
 #include <math.h>
 #include <vector>
@@ -17,6 +19,15 @@
 #include "object.hpp"
 #include "setupGL.hpp"
 #include "physics.hpp"
+#include "diagnostics.hpp"
+#include "trajectory.hpp"
+#include "checkpoint.hpp"
+#include "scenario.hpp"
+#include "playback.hpp"
+#include "publisher.hpp"
+#include "vtk_export.hpp"
+#include "jobs.hpp"
+#include "simulation.hpp"
 
 
 const unsigned int SCR_WIDTH = 1920;
@@ -37,9 +48,130 @@ const std::string block_v_shader("../projects/01-bouncing_ball/resources/shaders
 const std::string block_f_shader("../projects/01-bouncing_ball/resources/shaders/fragment.fs");
 const std::string light_v_shader("../projects/01-bouncing_ball/resources/shaders/light_cube.vs");
 const std::string light_f_shader("../projects/01-bouncing_ball/resources/shaders/light_cube.fs");
+const std::string default_scenario("../projects/01-bouncing_ball/resources/scenarios/default.scn");
+
+// Playback controls. Space: play / pause, Left / Right: step one frame,
+// Up / Down (held): scrub forward / backward at 4x, Home: back to the start
+static void updatePlayback(GLFWwindow* window, TrajectoryPlayer& player, double& cursor, bool& playing, std::vector<Sphere>& spheres)
+{
+    static bool space_down = false, left_down = false, right_down = false;
+    bool space = glfwGetKey(window, GLFW_KEY_SPACE) == GLFW_PRESS;
+    bool left = glfwGetKey(window, GLFW_KEY_LEFT) == GLFW_PRESS;
+    bool right = glfwGetKey(window, GLFW_KEY_RIGHT) == GLFW_PRESS;
+
+    if (space && !space_down)
+        playing = !playing;
+    int step = 0;
+    if (right && !right_down)
+        step = 1;
+    else if (left && !left_down)
+        step = -1;
+    space_down = space;
+    left_down = left;
+    right_down = right;
+
+    // Recorded frames per displayed frame
+    double rate = deltaTime / player.dt();
+    int direction = 1;
+    if (step != 0) {
+        playing = false;
+        cursor = std::floor(cursor) + step;
+        direction = step;
+    } else if (glfwGetKey(window, GLFW_KEY_UP) == GLFW_PRESS) {
+        cursor += 4.0 * rate;
+    } else if (glfwGetKey(window, GLFW_KEY_DOWN) == GLFW_PRESS) {
+        cursor -= 4.0 * rate;
+        direction = -1;
+    } else if (playing) {
+        cursor += rate;
+    }
+    if (glfwGetKey(window, GLFW_KEY_HOME) == GLFW_PRESS)
+        cursor = 0.0;
+
+    double last = (double)(player.frames() - 1);
+    cursor = std::min(std::max(cursor, 0.0), last);
+    if (cursor == last)
+        playing = false;
+
+    // While playing a chunk that is not there yet keeps the last frame on screen, a step waits for it
+    uint64_t frame = (uint64_t)cursor;
+    double time;
+    player.request(frame, direction);
+    player.load(frame, spheres, time, step != 0);
+}
 
 int main(int argc, char** argv)
 {
+    // --record <file>: save every frame
+    // --compress [bits]: quantize and entropy code the recording, positions on 2^bits steps across the box
+    // --restore <file>: start from a checkpoint
+    // --autosave <file> [seconds]: checkpoint periodically and on exit
+    // --scenario <file>: scene description, compiled once to <file>.cache
+    // --play <file>: show a recording instead of simulating
+    // --publish [name]: live state in POSIX shared memory for other processes (shared_state.hpp)
+    // --export-vtk <file> <prefix> [stride]: convert a recording for ParaView and exit
+    // --sim-rate <hz>: physics steps per second of sim time, 0 to step as fast as possible
+    std::string record_file, restore_file, autosave_file, play_file, publish_name;
+    std::string export_file, export_prefix;
+    uint64_t export_stride = 1;
+    std::string scenario_file = default_scenario;
+    double autosave_interval = 60.0;
+    bool compress = false;
+    unsigned int position_bits = 16;
+    double sim_rate = 120.0;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg(argv[i]);
+        if (arg == "--record" && i + 1 < argc)
+            record_file = argv[++i];
+        else if (arg == "--compress") {
+            compress = true;
+            if (i + 1 < argc && argv[i + 1][0] != '-')
+                position_bits = std::atoi(argv[++i]);
+        }
+        else if (arg == "--restore" && i + 1 < argc)
+            restore_file = argv[++i];
+        else if (arg == "--scenario" && i + 1 < argc)
+            scenario_file = argv[++i];
+        else if (arg == "--sim-rate" && i + 1 < argc)
+            sim_rate = std::atof(argv[++i]);
+        else if (arg == "--play" && i + 1 < argc)
+            play_file = argv[++i];
+        else if (arg == "--export-vtk" && i + 2 < argc) {
+            export_file = argv[++i];
+            export_prefix = argv[++i];
+            if (i + 1 < argc && argv[i + 1][0] != '-')
+                export_stride = std::atoll(argv[++i]);
+        }
+        else if (arg == "--publish") {
+            publish_name = "/physics-sim";
+            if (i + 1 < argc && argv[i + 1][0] != '-')
+                publish_name = argv[++i];
+        }
+        else if (arg == "--autosave" && i + 1 < argc) {
+            autosave_file = argv[++i];
+            if (i + 1 < argc && argv[i + 1][0] != '-')
+                autosave_interval = std::atof(argv[++i]);
+        }
+    }
+
+    if (!export_file.empty())
+        return exportVTK(export_file, export_prefix, export_stride) ? 0 : -1;
+
+    Scenario scenario;
+    if (!loadScenario(scenario_file, scenario))
+        return -1;
+
+    // Opened before the window: a bad recording exits without one to tear down
+    TrajectoryPlayer player;
+    if (!play_file.empty()) {
+        if (!player.open(play_file))
+            return -1;
+        if (player.frames() == 0) {
+            std::cout << "ERROR::PLAYBACK::NO_FRAMES " << play_file << std::endl;
+            return -1;
+        }
+    }
+
     std::string title = "PhysicsSim";
     unsigned int width = 1920;
     unsigned int height = 1080;
@@ -52,7 +184,8 @@ int main(int argc, char** argv)
     // Create a cube -> light and box to keep balls inside
     Cube cube;
 
-    glm::vec3 cubePosition(0.0f,  0.0f,  0.0f);
+    glm::vec3 cubePosition = scenario.box_center;
+    float halfBox = 0.5f * scenario.box_size;
 
     // Define light stuff
     glm::vec3 lightPos(0.0f, 0.6f, 0.0f);
@@ -61,19 +194,9 @@ int main(int argc, char** argv)
 
     Sphere2 sphere;
 
-    unsigned int n_spheres = 1000;
-    std::vector<Sphere> spheres(n_spheres);
-
-    double xmin=-0.5f, xmax=0.5f;         // The box is centered at (0,0,0) and side of size of 0.5.
-    double vmin=-0.001f, vmax=0.001f;
-
-    for (std::vector<Sphere>::iterator it = spheres.begin(); it!=spheres.end(); ++it){
-        it->pos = glm::linearRand(glm::vec3(xmin), glm::vec3(xmax));
-        it->vel = glm::linearRand(glm::vec3(vmin), glm::vec3(vmax));
-        it->color = glm::linearRand(glm::vec3(0.0f), glm::vec3(1.0f));
-        it->radius = 0.03;
-        it->m = M_PI * it->radius * it->radius;
-    }
+    unsigned int seed = scenario.seed;
+    std::vector<Sphere> spheres;
+    spheres.swap(scenario.spheres);
 
     // Transforms
     glm::mat4 proj;
@@ -82,7 +205,98 @@ int main(int argc, char** argv)
 
 
     glEnable(GL_DEPTH_TEST);
-    unsigned int n_substeps = 5;
+    // Fast balls get continuous collision detection, the substeps only help the resting contacts
+    unsigned int n_substeps = scenario.n_substeps;
+
+    // Sim time, carried over by checkpoints
+    double sim_time = 0.0;
+    if (!restore_file.empty()) {
+        Checkpoint checkpoint;
+        if (loadCheckpoint(restore_file, checkpoint, spheres)) {
+            seed = checkpoint.seed;
+            n_substeps = checkpoint.n_substeps;
+            sim_time = checkpoint.time;
+            camera = Camera(checkpoint.position, glm::vec3(0.0f, 1.0f, 0.0f), checkpoint.yaw, checkpoint.pitch);
+            camera.Zoom = checkpoint.zoom;
+            // The light keeps turning from where it was
+            glfwSetTime(sim_time);
+            lastFrame = sim_time;
+        }
+    }
+    std::unique_ptr<Autosave> autosave;
+    if (!autosave_file.empty())
+        autosave.reset(new Autosave(autosave_file, autosave_interval));
+    auto checkpoint = [&]() {
+        Checkpoint c = makeCheckpoint(spheres.size(), sim_time, seed, n_substeps);
+        c.position = camera.Position;
+        c.yaw = camera.Yaw;
+        c.pitch = camera.Pitch;
+        c.zoom = camera.Zoom;
+        return c;
+    };
+
+    // Playback: the spheres come from the recording, frame by frame
+    double cursor = 0.0;
+    bool playing = true;
+    if (player.isOpen()) {
+        double start;
+        player.request(0);
+        player.load(0, spheres, start, true);
+    }
+
+    // Physics on its own thread, stepped at sim_rate whatever the frame rate
+    Simulation simulation;
+    simulation.centerBox = cubePosition;
+    simulation.halfBox = halfBox;
+    simulation.n_substeps = n_substeps;
+    simulation.ccd_threshold = scenario.ccd_threshold;
+    simulation.realtime = sim_rate > 0.0;
+    simulation.dt = 1.0f / (sim_rate > 0.0 ? sim_rate : 120.0);
+
+    // Total energy and momentum, sampled every 60 steps
+    EnergyMonitor energyMonitor(60, 0.05);
+
+    TrajectoryRecorder recorder;
+    if (!record_file.empty()) {
+        uint32_t schema = SCHEMA_POS | SCHEMA_VEL;
+        if (compress) {
+            schema |= SCHEMA_COMPRESSED;
+            recorder.codec.box_min = cubePosition - glm::vec3(halfBox);
+            recorder.codec.box_max = cubePosition + glm::vec3(halfBox);
+            recorder.codec.position_bits = position_bits;
+        }
+        recorder.open(record_file, spheres, simulation.dt, schema);
+    }
+
+    StatePublisher publisher;
+    if (!publish_name.empty())
+        publisher.open(publish_name, spheres.size());
+
+    // Consumers of each completed state, run as parallel jobs: on a job of the simulation thread
+    // while it computes the next step, or on the render thread for a recording. The jobs are
+    // created once and reset for each state, so consuming a step allocates nothing.
+    JobSystem& jobs = JobSystem::instance();
+    const std::vector<Sphere>* consumed = &spheres;
+    double consumed_time = 0.0;
+    JobHandle consumers[] = {
+        jobs.create([&]() { energyMonitor.update(*consumed); }, true),
+        jobs.create([&]() { recorder.record(*consumed, consumed_time); }, true),
+        jobs.create([&]() { publisher.publish(*consumed, consumed_time); }, true)
+    };
+    auto consume = [&](const std::vector<Sphere>& state, double time) {
+        consumed = &state;
+        consumed_time = time;
+        for (JobHandle& job : consumers) {
+            jobs.reset(job);
+            jobs.submit(job);
+        }
+        for (JobHandle& job : consumers)
+            jobs.wait(job);
+    };
+    if (!player.isOpen()) {
+        simulation.onStep = [&](const SimState& state) { consume(state.spheres, state.time); };
+        simulation.start(spheres, sim_time);
+    }
 
     // render loop
     // -----------
@@ -94,11 +308,24 @@ int main(int argc, char** argv)
 
         // Time for frame
         std::streamsize prec = std::cout.precision();
-        std::cout << std::setprecision(5) << deltaTime << " ms\r" << std::setprecision(prec) << std::flush;
+        std::cout << std::setprecision(5) << deltaTime << " ms, " << simulation.stepRate() << " steps/s   \r"
+                  << std::setprecision(prec) << std::flush;
 
         // process inputs
         processInput(window);
 
+        // Latest state of the simulation, never waits for the step in progress
+        const std::vector<Sphere>* drawn = &spheres;
+        if (player.isOpen()) {
+            updatePlayback(window, player, cursor, playing, spheres);
+            sim_time += deltaTime;
+            consume(spheres, sim_time);
+        } else {
+            const SimState& state = simulation.latest();
+            drawn = &state.spheres;
+            sim_time = state.time;
+        }
+
         // rendering commands
         glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
@@ -125,34 +352,23 @@ int main(int argc, char** argv)
         glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
         model = glm::mat4(1.0f);
         model = glm::translate(model, cubePosition);
+        model = glm::scale(model, glm::vec3(scenario.box_size));
         blockShader.setMat4f("model", model);
         cube.Draw();
         glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
 
         // Sphere
         // Use same shader as for block
-        for (std::vector<Sphere>::iterator it=spheres.begin(); it!=spheres.end(); ++it){
-            // Draw
+        for (std::vector<Sphere>::const_iterator it=drawn->begin(); it!=drawn->end(); ++it){
             model = glm::mat4(1.0f);
             model = glm::translate(model, it->pos);
             model = glm::scale(model, glm::vec3(1.0f, 1.0f, 1.0f) * it->radius);
             blockShader.setMat4f("model", model);
             blockShader.set3f("objectColor", it->color);
             sphere.Draw();
-
-            // Create substeps for stability
-            float dt = deltaTime / n_substeps;
-            for (unsigned int step=0; step!= n_substeps; ++step){
-                // Move the ball i.e. update position and speed
-                move(*it, dt, cubePosition);
-
-                // Check for collisions
-                for (std::vector<Sphere>::iterator it2=spheres.begin(); it2!=spheres.end(); ++it2){
-                    if (it != it2)
-                        collision(*it, *it2);
-                }
-            }
         }
+        if (autosave)
+            autosave->update(checkpoint(), *drawn);
 
         // Draw the light!
         lightShader.use();
@@ -173,6 +389,24 @@ int main(int argc, char** argv)
 
     // glfw: terminate, clear all previous allocated GLFW resources
     // ------------------------------------------------------------
+    simulation.stop();
+    if (!player.isOpen()) {
+        spheres = simulation.latest().spheres;
+        sim_time = simulation.latest().time;
+        std::cout << "Physics arena high water: " << simulation.arenaHighWater() / 1024.0 << " KiB" << std::endl;
+    }
+    recorder.close();
+    if (!record_file.empty()) {
+        AsyncWriterMetrics writes = recorder.writerMetrics();
+        std::cout << "Recorded " << recorder.frames() << " frames: " << writes.writes << " writes (" << writes.backend
+                  << (writes.direct ? ", O_DIRECT" : "") << "), max queue depth " << writes.max_in_flight
+                  << ", stalled " << recorder.stallTime() << " s" << std::endl;
+    }
+    if (autosave) {
+        // Waits for a save still running, the final one must not be overwritten
+        autosave.reset();
+        saveCheckpoint(autosave_file, checkpoint(), spheres);
+    }
     glfwDestroyWindow(window);
     glfwTerminate();
     return 0;
@@ -1,18 +1,30 @@
 #include <glm/glm.hpp>
 
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <vector>
+
 #include "object.hpp"
+#include "physics.hpp"
+#include "arena.hpp"
 
 
-float energy(glm::vec3 pos, glm::vec3 v){
-    glm::vec3 g(0.0f, -10.f, 0.0f);
-    return -g.y*pos.y + 0.5 * dot(v, v);
+void energyTerms(const Sphere& s, double& kinetic, double& potential){
+    glm::dvec3 g(0.0, -10.0, 0.0);
+    glm::dvec3 v(s.vel);
+    kinetic = 0.5 * s.m * glm::dot(v, v);
+    potential = -g.y * s.m * s.pos.y;
 };
 
+float energy(const Sphere& s){
+    double kinetic, potential;
+    energyTerms(s, kinetic, potential);
+    return kinetic + potential;
+};
 
-void collision(Sphere& s1, Sphere& s2){
-    // elasticity
-    float e = 0.95f;
 
+void collision(Sphere& s1, Sphere& s2){
     glm::vec3 normal(s2.pos - s1.pos);
     float d = glm::length(normal);
 
@@ -26,6 +38,14 @@ void collision(Sphere& s1, Sphere& s2){
     s1.pos -= corr * normal;
     s2.pos += corr * normal;
 
+    bounce(s1, s2, normal);
+};
+
+
+void bounce(Sphere& s1, Sphere& s2, glm::vec3 normal){
+    // elasticity
+    float e = 0.95f;
+
     float v1n = glm::dot(s1.vel, normal);
     float v2n = glm::dot(s2.vel, normal);
 
@@ -40,7 +60,7 @@ void collision(Sphere& s1, Sphere& s2){
 };
 
 
-void move(Sphere& s, float dt, glm::vec3 centerBox){
+void move(Sphere& s, float dt, glm::vec3 centerBox, float halfBox){
     /*
      F = ma
      F = m dv/dt
@@ -57,26 +77,149 @@ void move(Sphere& s, float dt, glm::vec3 centerBox){
     s.vel += g * dt;
     s.pos += s.vel * dt;
 
-    if (s.pos.y - s.radius < centerBox.y - 0.5){
+    if (s.pos.y - s.radius < centerBox.y - halfBox){
         // Remove the potential energy gained from the velocity
         // dE = 0 => mgdh = -mvdv => dv = -gdh/v => v = v - gdh/v
-        // dh = centerBox.y - 0.5 - (s.pos.y - s.radius) ;
+        // dh = centerBox.y - halfBox - (s.pos.y - s.radius) ;
         // s.vel.y -= g.y * dh / s.vel.y;
-        s.pos.y = centerBox.y - 0.5 + s.radius;
+        s.pos.y = centerBox.y - halfBox + s.radius;
         s.vel.y = -s.vel.y;
     }
-    if (s.pos.x + s.radius > centerBox.x + 0.5 ){
-        s.pos.x = centerBox.x + 0.5 - s.radius;
+    if (s.pos.x + s.radius > centerBox.x + halfBox ){
+        s.pos.x = centerBox.x + halfBox - s.radius;
         s.vel.x = -s.vel.x;
-    } else if (s.pos.x - s.radius < centerBox.x - 0.5){
-        s.pos.x = centerBox.x - 0.5 + s.radius;
+    } else if (s.pos.x - s.radius < centerBox.x - halfBox){
+        s.pos.x = centerBox.x - halfBox + s.radius;
         s.vel.x = -s.vel.x;
     }
-    if (s.pos.z + s.radius > centerBox.z + 0.5 ){
-        s.pos.z = centerBox.z + 0.5 - s.radius;
+    if (s.pos.z + s.radius > centerBox.z + halfBox ){
+        s.pos.z = centerBox.z + halfBox - s.radius;
         s.vel.z = -s.vel.z;
-    } else if (s.pos.z - s.radius < centerBox.z - 0.5){
-        s.pos.z = centerBox.z - 0.5 + s.radius;
+    } else if (s.pos.z - s.radius < centerBox.z - halfBox){
+        s.pos.z = centerBox.z - halfBox + s.radius;
         s.vel.z = -s.vel.z;
     }
 }
+
+
+bool isFast(const Sphere& s, float dt, float threshold){
+    glm::vec3 g(0.0f, -10.f, 0.0f);
+    glm::vec3 d = (s.vel + g * dt) * dt;
+    float limit = threshold * s.radius;
+    return glm::dot(d, d) > limit * limit;
+}
+
+
+// Fraction of the displacement d after which s touches a wall of the box, wall = -1 if none
+static float wallImpact(const Sphere& s, glm::vec3 d, glm::vec3 centerBox, float halfBox, int& wall){
+    float toi = std::numeric_limits<float>::max();
+    wall = -1;
+    for (int axis = 0; axis != 3; ++axis) {
+        // The box is open at the top
+        for (int side = (axis == 1 ? 0 : 1); side >= 0; --side) {
+            float plane = side ? centerBox[axis] + halfBox - s.radius : centerBox[axis] - halfBox + s.radius;
+            float gap = side ? plane - s.pos[axis] : s.pos[axis] - plane;
+            float closing = side ? d[axis] : -d[axis];
+            if (closing <= 0.0f || gap < 0.0f || gap > closing)
+                continue;
+            if (gap / closing < toi) {
+                toi = gap / closing;
+                wall = axis;
+            }
+        }
+    }
+    return toi;
+}
+
+// Fraction of the displacement d after which s touches o: ray against o inflated by the radius of s
+static float sphereImpact(const Sphere& s, glm::vec3 d, const Sphere& o){
+    float r = s.radius + o.radius;
+    glm::vec3 p = s.pos - o.pos;
+    float c = glm::dot(p, p) - r * r;
+    float b = glm::dot(p, d);
+    float a = glm::dot(d, d);
+
+    // Already overlapping (left to collision()) or moving away
+    if (c < 0.0f || b >= 0.0f)
+        return std::numeric_limits<float>::max();
+
+    float delta = b * b - a * c;
+    if (delta < 0.0f)
+        return std::numeric_limits<float>::max();
+
+    float t = (-b - std::sqrt(delta)) / a;
+    return t <= 1.0f ? std::max(t, 0.0f) : std::numeric_limits<float>::max();
+}
+
+
+// Indices (in order) of the spheres s can touch while moving at most reach from its position
+static void gatherCandidates(const std::vector<Sphere>& spheres, size_t i, float reach, ArenaVector<uint32_t>& candidates){
+    const Sphere& s = spheres[i];
+    candidates.clear();
+    for (size_t j = 0; j != spheres.size(); ++j) {
+        glm::vec3 p = spheres[j].pos - s.pos;
+        float r = reach + s.radius + spheres[j].radius;
+        if (j != i && glm::dot(p, p) <= r * r)
+            candidates.push_back(j);
+    }
+}
+
+
+void moveSwept(std::vector<Sphere>& spheres, size_t i, float dt, glm::vec3 centerBox, float halfBox){
+    // Same integration as move(): velocity first, then the position along a straight segment
+    glm::vec3 g(0.0f, -10.f, 0.0f);
+    Sphere& s = spheres[i];
+    s.vel += g * dt;
+
+    // The impacts are only searched among the spheres within reach of the gather point. Walls
+    // keep the speed so one gather usually serves the whole sweep; a faster bounce gathers again.
+    Arena& arena = frameArena();
+    ArenaScope scope(arena);
+    ArenaVector<uint32_t> candidates{ArenaAllocator<uint32_t>(arena)};
+    candidates.reserve(spheres.size());
+    glm::vec3 gathered = s.pos;
+    float reach = -1.0f;
+
+    // Walk the segment from impact to impact, the other spheres are frozen meanwhile
+    const int MAX_IMPACTS = 8;
+    float remaining = dt;
+    for (int n = 0; n != MAX_IMPACTS && remaining > 0.0f; ++n) {
+        glm::vec3 d = s.vel * remaining;
+
+        float needed = glm::length(s.pos - gathered) + glm::length(d);
+        if (needed > reach) {
+            // A little slack, extra candidates change nothing
+            reach = glm::length(d) * 1.001f + 1e-6f;
+            gathered = s.pos;
+            gatherCandidates(spheres, i, reach, candidates);
+        }
+
+        int wall;
+        float toi = wallImpact(s, d, centerBox, halfBox, wall);
+        size_t other = spheres.size();
+        for (size_t k = 0; k != candidates.size(); ++k) {
+            size_t j = candidates[k];
+            float t = sphereImpact(s, d, spheres[j]);
+            if (t < toi) {
+                toi = t;
+                other = j;
+            }
+        }
+
+        if (toi > 1.0f) {
+            s.pos += d;
+            break;
+        }
+
+        s.pos += toi * d;
+        remaining *= 1.0f - toi;
+        if (other != spheres.size()) {
+            bounce(s, spheres[other], glm::normalize(spheres[other].pos - s.pos));
+        } else {
+            s.vel[wall] = -s.vel[wall];
+        }
+    }
+
+    // Keep the walls as hard limits in case the impacts ran out
+    move(s, 0.0f, centerBox, halfBox);
+}
@@ -0,0 +1,258 @@
+#include <glm/glm.hpp>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "playback.hpp"
+#include "codec.hpp"
+
+
+TrajectoryPlayer::TrajectoryPlayer(): map(nullptr), map_bytes(0), frame_bytes(0), stop(false) {
+    header = TrajectoryHeader();
+};
+
+TrajectoryPlayer::~TrajectoryPlayer() {
+    close();
+};
+
+bool TrajectoryPlayer::open(const std::string& filename) {
+    close();
+
+    int fd = ::open(filename.c_str(), O_RDONLY);
+    if (fd < 0) {
+        std::cout << "ERROR::PLAYBACK::FILE_NOT_SUCCESSFULLY_OPENED " << filename << std::endl;
+        return false;
+    }
+    struct stat st;
+    if (::fstat(fd, &st) != 0 || (uint64_t)st.st_size < TRAJECTORY_BLOCK) {
+        std::cout << "ERROR::PLAYBACK::TRUNCATED " << filename << std::endl;
+        ::close(fd);
+        return false;
+    }
+    void* data = ::mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (data == MAP_FAILED) {
+        std::cout << "ERROR::PLAYBACK::MMAP_FAILED " << filename << std::endl;
+        return false;
+    }
+    map = (unsigned char*)data;
+    map_bytes = st.st_size;
+    // Read ahead is done by the prefetch thread, one chunk at a time
+    ::madvise(map, map_bytes, MADV_RANDOM);
+
+    // The header is written last: a recording that was not closed has none
+    std::memcpy(&header, map, sizeof(header));
+    if (std::memcmp(header.magic, TRAJECTORY_MAGIC, sizeof(header.magic)) != 0 || header.version > TRAJECTORY_VERSION) {
+        std::cout << "ERROR::PLAYBACK::NOT_A_TRAJECTORY " << filename << std::endl;
+        close();
+        return false;
+    }
+    uint64_t n = header.n_particles;
+    frame_bytes = frameBytes(header.schema, n);
+    bool ok = header.n_chunks != 0
+           && header.index_offset + header.n_chunks * sizeof(ChunkInfo) <= map_bytes
+           && header.static_offset + 4 * n * sizeof(float) <= map_bytes;
+    if (ok) {
+        const ChunkInfo* first = (const ChunkInfo*)(map + header.index_offset);
+        index.assign(first, first + header.n_chunks);
+        // The chunks must also follow each other without gap: chunkOf() relies on it
+        uint64_t next = 0;
+        for (std::vector<ChunkInfo>::iterator it = index.begin(); it != index.end(); ++it) {
+            ok = ok && validChunk(header, *it, map_bytes) && it->first_frame == next;
+            next = it->first_frame + it->n_frames;
+        }
+        ok = ok && next == header.n_frames;
+    }
+    if (!ok) {
+        std::cout << "ERROR::PLAYBACK::TRUNCATED " << filename << std::endl;
+        close();
+        return false;
+    }
+    const float* s = (const float*)(map + header.static_offset);
+    statics.assign(s, s + 4 * n);
+
+    stop = false;
+    wanted.clear();
+    prefetcher = std::thread(&TrajectoryPlayer::prefetch, this);
+    return true;
+};
+
+void TrajectoryPlayer::close() {
+    if (prefetcher.joinable()) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stop = true;
+        }
+        cv.notify_all();
+        prefetcher.join();
+    }
+    if (map != nullptr)
+        ::munmap(map, map_bytes);
+    map = nullptr;
+    map_bytes = 0;
+    header = TrajectoryHeader();
+    index.clear();
+    statics.clear();
+    wanted.clear();
+    for (int s = 0; s != N_SLOTS; ++s) {
+        slots[s].chunk = NO_CHUNK;
+        slots[s].ready = false;
+        slots[s].frames = nullptr;
+        slots[s].decoded = std::vector<unsigned char>();
+    }
+};
+
+uint64_t TrajectoryPlayer::chunkOf(uint64_t frame) const {
+    // Last chunk whose first frame is <= frame
+    std::vector<ChunkInfo>::const_iterator it = std::upper_bound(index.begin(), index.end(), frame,
+        [](uint64_t f, const ChunkInfo& info) { return f < info.first_frame; });
+    return it == index.begin() ? 0 : (it - index.begin()) - 1;
+};
+
+int TrajectoryPlayer::find(uint64_t chunk) const {
+    for (int s = 0; s != N_SLOTS; ++s) {
+        if (slots[s].chunk == chunk)
+            return s;
+    }
+    return -1;
+};
+
+void TrajectoryPlayer::request(uint64_t frame, int direction) {
+    if (!isOpen() || header.n_frames == 0)
+        return;
+    uint64_t chunk = chunkOf(std::min(frame, header.n_frames - 1));
+
+    // One slot stays out of the window so that a new chunk never evicts a wanted one
+    std::vector<uint64_t> window;
+    for (int k = 0; k != N_SLOTS - 1; ++k) {
+        int64_t c = (int64_t)chunk + k * (direction < 0 ? -1 : 1);
+        if (c < 0 || c >= (int64_t)index.size())
+            break;
+        window.push_back(c);
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    if (window != wanted) {
+        wanted.swap(window);
+        cv.notify_all();
+    }
+};
+
+bool TrajectoryPlayer::load(uint64_t frame, std::vector<Sphere>& spheres, double& time, bool wait) {
+    if (!isOpen() || frame >= header.n_frames)
+        return false;
+    uint64_t chunk = chunkOf(frame);
+
+    std::unique_lock<std::mutex> lock(mutex);
+    int s = find(chunk);
+    if (s < 0 || !slots[s].ready) {
+        if (!wait)
+            return false;
+        if (std::find(wanted.begin(), wanted.end(), chunk) == wanted.end()) {
+            wanted.insert(wanted.begin(), chunk);
+            wanted.resize(std::min<size_t>(wanted.size(), N_SLOTS - 1));
+            cv.notify_all();
+        }
+        cv.wait(lock, [&]() { s = find(chunk); return s >= 0 && slots[s].ready; });
+    }
+
+    // Copied under the lock: the slot cannot be evicted meanwhile
+    const unsigned char* f = slots[s].frames + (frame - index[chunk].first_frame) * frame_bytes;
+    std::memcpy(&time, f, sizeof(double));
+    const float* column = (const float*)(f + sizeof(double));
+
+    uint64_t n = header.n_particles;
+    spheres.resize(n);
+    for (uint64_t i = 0; i != n; ++i) {
+        Sphere& sphere = spheres[i];
+        sphere.radius = statics[i];
+        sphere.color = glm::vec3(statics[n + i], statics[2 * n + i], statics[3 * n + i]);
+        sphere.m = M_PI * sphere.radius * sphere.radius;
+    }
+    if (header.schema & SCHEMA_POS) {
+        for (uint64_t i = 0; i != n; ++i)
+            spheres[i].pos = glm::vec3(column[i], column[n + i], column[2 * n + i]);
+        column += 3 * n;
+    }
+    if (header.schema & SCHEMA_VEL) {
+        for (uint64_t i = 0; i != n; ++i)
+            spheres[i].vel = glm::vec3(column[i], column[n + i], column[2 * n + i]);
+    }
+    return true;
+};
+
+void TrajectoryPlayer::prefetch() {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        uint64_t chunk = NO_CHUNK;
+        cv.wait(lock, [&]() {
+            if (stop)
+                return true;
+            for (std::vector<uint64_t>::iterator it = wanted.begin(); it != wanted.end(); ++it) {
+                if (find(*it) < 0) {
+                    chunk = *it;
+                    return true;
+                }
+            }
+            return false;
+        });
+        if (stop)
+            return;
+
+        // An empty slot, else one out of the window: there are at least two
+        int victim = -1;
+        for (int s = 0; s != N_SLOTS && victim < 0; ++s) {
+            if (slots[s].chunk == NO_CHUNK)
+                victim = s;
+        }
+        for (int s = 0; s != N_SLOTS && victim < 0; ++s) {
+            if (std::find(wanted.begin(), wanted.end(), slots[s].chunk) == wanted.end())
+                victim = s;
+        }
+        Slot& slot = slots[victim];
+        if (slot.chunk != NO_CHUNK && !(index[slot.chunk].flags & CHUNK_COMPRESSED)) {
+            // Give the pages back, a recording larger than memory only keeps the window resident
+            const ChunkInfo& old = index[slot.chunk];
+            ::madvise(map + old.offset, alignBlock(old.bytes), MADV_DONTNEED);
+        }
+        slot.chunk = chunk;
+        slot.ready = false;
+
+        lock.unlock();
+        fetch(slot, chunk);
+        lock.lock();
+        slot.ready = true;
+        cv.notify_all();
+    }
+};
+
+void TrajectoryPlayer::fetch(Slot& slot, uint64_t chunk) {
+    const ChunkInfo& info = index[chunk];
+    unsigned char* data = map + info.offset;
+
+    if (info.flags & CHUNK_COMPRESSED) {
+        slot.decoded.resize(info.n_frames * frame_bytes);
+        if (!decodeChunk(header, data, info.bytes, info.n_frames, slot.decoded.data())) {
+            std::cout << "ERROR::PLAYBACK::CORRUPT_CHUNK " << chunk << std::endl;
+            std::fill(slot.decoded.begin(), slot.decoded.end(), 0);
+        }
+        slot.frames = slot.decoded.data();
+        ::madvise(data, alignBlock(info.bytes), MADV_DONTNEED);
+    } else {
+        // Fault the pages in here rather than on the render thread
+        ::madvise(data, alignBlock(info.bytes), MADV_WILLNEED);
+        volatile unsigned char touch = 0;
+        for (uint64_t b = 0; b < info.bytes; b += TRAJECTORY_BLOCK)
+            touch ^= data[b];
+        slot.frames = data;
+    }
+};
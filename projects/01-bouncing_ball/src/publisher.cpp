@@ -0,0 +1,108 @@
+#include <glm/glm.hpp>
+
+#include <cstring>
+#include <iostream>
+#include <new>
+#include <string>
+#include <vector>
+
+#include "publisher.hpp"
+
+
+StatePublisher::StatePublisher(): header(nullptr), bytes(0), step(0) {};
+
+StatePublisher::~StatePublisher() {
+    close();
+};
+
+bool StatePublisher::open(const std::string& name, uint64_t n_particles, uint32_t n_slots) {
+    close();
+
+    uint64_t slot_bytes = sharedSlotBytes(n_particles);
+    uint64_t data_offset = (sizeof(SharedStateHeader) + SHARED_STATE_ALIGN - 1) / SHARED_STATE_ALIGN * SHARED_STATE_ALIGN;
+    bytes = data_offset + n_slots * slot_bytes;
+
+    // A segment left by a crashed run is replaced
+    ::shm_unlink(name.c_str());
+    int fd = ::shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0644);
+    if (fd < 0 || ::ftruncate(fd, bytes) != 0) {
+        std::cout << "ERROR::PUBLISHER::SHM_NOT_CREATED " << name << std::endl;
+        if (fd >= 0) {
+            ::close(fd);
+            ::shm_unlink(name.c_str());
+        }
+        return false;
+    }
+    void* data = ::mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (data == MAP_FAILED) {
+        std::cout << "ERROR::PUBLISHER::MMAP_FAILED " << name << std::endl;
+        ::shm_unlink(name.c_str());
+        return false;
+    }
+
+    // ftruncate zeroed the segment: every slot starts even and the ring empty
+    this->name = name;
+    header = new (data) SharedStateHeader;
+    header->version = SHARED_STATE_VERSION;
+    header->n_slots = n_slots;
+    header->n_particles = n_particles;
+    header->slot_bytes = slot_bytes;
+    header->data_offset = data_offset;
+    header->latest.store(0, std::memory_order_relaxed);
+    for (uint32_t s = 0; s != n_slots; ++s) {
+        SharedStateSlot* slot = new ((char*)data + data_offset + s * slot_bytes) SharedStateSlot;
+        slot->sequence.store(0, std::memory_order_relaxed);
+    }
+    // The magic goes last: a reader attaching early refuses a half initialized segment
+    std::atomic_thread_fence(std::memory_order_release);
+    std::memcpy(header->magic, SHARED_STATE_MAGIC, sizeof(header->magic));
+    step = 0;
+    return true;
+};
+
+void StatePublisher::publish(const std::vector<Sphere>& spheres, double time) {
+    if (header == nullptr || spheres.size() != header->n_particles)
+        return;
+
+    uint64_t n = header->n_particles;
+    SharedStateSlot* slot = (SharedStateSlot*)((char*)header + header->data_offset + (step % header->n_slots) * header->slot_bytes);
+    uint64_t column = sharedColumnBytes(n);
+    char* first = (char*)slot + sizeof(SharedStateSlot);
+    float* x = (float*)first;
+    float* y = (float*)(first + column);
+    float* z = (float*)(first + 2 * column);
+    float* vx = (float*)(first + 3 * column);
+    float* vy = (float*)(first + 4 * column);
+    float* vz = (float*)(first + 5 * column);
+
+    // Seqlock: odd while the slot is written
+    uint64_t sequence = slot->sequence.load(std::memory_order_relaxed);
+    slot->sequence.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    slot->step = step;
+    slot->time = time;
+    for (uint64_t i = 0; i != n; ++i) {
+        const Sphere& s = spheres[i];
+        x[i] = s.pos.x;
+        y[i] = s.pos.y;
+        z[i] = s.pos.z;
+        vx[i] = s.vel.x;
+        vy[i] = s.vel.y;
+        vz[i] = s.vel.z;
+    }
+
+    slot->sequence.store(sequence + 2, std::memory_order_release);
+    ++step;
+    header->latest.store(step, std::memory_order_release);
+};
+
+void StatePublisher::close() {
+    if (header == nullptr)
+        return;
+    ::munmap(header, bytes);
+    ::shm_unlink(name.c_str());
+    header = nullptr;
+    bytes = 0;
+};
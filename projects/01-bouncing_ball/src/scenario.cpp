@@ -0,0 +1,283 @@
+#include <glm/glm.hpp>
+#include <glm/gtc/random.hpp>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "scenario.hpp"
+
+static const char CACHE_MAGIC[8] = {'P', 'H', 'Y', 'S', 'S', 'C', 'N', 'C'};
+static const uint32_t CACHE_VERSION = 1;
+
+// Cache file: this header, then the spheres as they are in memory
+struct CacheHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t sphere_size;
+    uint64_t hash;              // of the scenario text
+    uint64_t n_spheres;
+    uint32_t seed;
+    uint32_t n_substeps;
+    glm::vec3 box_center;
+    float box_size;
+    float ccd_threshold;
+};
+
+enum Distribution_Type {
+    DIST_CONST,
+    DIST_UNIFORM,
+    DIST_BALL,
+    DIST_NORMAL
+};
+
+struct Distribution {
+    Distribution_Type type = DIST_CONST;
+    glm::vec3 a = glm::vec3(0.0f);
+    glm::vec3 b = glm::vec3(0.0f);
+    float r = 0.0f;
+
+    glm::vec3 sample() const {
+        switch (type) {
+            case DIST_UNIFORM: return glm::linearRand(a, b);
+            case DIST_BALL: return a + glm::ballRand(r);
+            case DIST_NORMAL: return glm::gaussRand(a, glm::vec3(r));
+            default: return a;
+        }
+    };
+};
+
+struct Species {
+    std::string name;
+    unsigned long count = 0;
+    float radius_lo = 0.03f, radius_hi = 0.03f;
+    float mass = -1.0f;             // < 0: pi r^2 like the original scene
+    Distribution position, velocity, color;
+};
+
+
+uint64_t fnv1a(const void* data, size_t bytes, uint64_t hash) {
+    const unsigned char* p = (const unsigned char*)data;
+    for (size_t i = 0; i != bytes; ++i) {
+        hash ^= p[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+static bool readVec3(std::istringstream& in, glm::vec3& v) {
+    return (bool)(in >> v.x >> v.y >> v.z);
+}
+
+static bool readDistribution(std::istringstream& in, Distribution& d) {
+    std::string type;
+    in >> type;
+    if (type == "const") {
+        d.type = DIST_CONST;
+        return readVec3(in, d.a);
+    } else if (type == "uniform") {
+        d.type = DIST_UNIFORM;
+        return readVec3(in, d.a) && readVec3(in, d.b);
+    } else if (type == "ball") {
+        d.type = DIST_BALL;
+        return readVec3(in, d.a) && (in >> d.r);
+    } else if (type == "normal") {
+        d.type = DIST_NORMAL;
+        return readVec3(in, d.a) && (in >> d.r);
+    }
+    return false;
+}
+
+bool compileScenario(const std::string& text, Scenario& scenario) {
+    scenario = Scenario();
+    std::vector<Species> species;
+    Species* current = nullptr;
+
+    std::istringstream lines(text);
+    std::string line;
+    for (int n_line = 1; std::getline(lines, line); ++n_line) {
+        std::string::size_type comment = line.find('#');
+        if (comment != std::string::npos)
+            line.erase(comment);
+
+        std::istringstream in(line);
+        std::string key;
+        if (!(in >> key))
+            continue;
+
+        bool ok = true;
+        if (current == nullptr) {
+            if (key == "seed") {
+                ok = (bool)(in >> scenario.seed);
+            } else if (key == "box") {
+                std::string field;
+                while (ok && in >> field) {
+                    if (field == "center")
+                        ok = readVec3(in, scenario.box_center);
+                    else if (field == "size")
+                        ok = (bool)(in >> scenario.box_size);
+                    else
+                        ok = false;
+                }
+            } else if (key == "solver") {
+                std::string field;
+                while (ok && in >> field) {
+                    if (field == "substeps")
+                        ok = (bool)(in >> scenario.n_substeps);
+                    else if (field == "ccd_threshold")
+                        ok = (bool)(in >> scenario.ccd_threshold);
+                    else
+                        ok = false;
+                }
+            } else if (key == "species") {
+                species.push_back(Species());
+                current = &species.back();
+                in >> current->name;
+            } else {
+                ok = false;
+            }
+        } else {
+            if (key == "end") {
+                current = nullptr;
+            } else if (key == "count") {
+                ok = (bool)(in >> current->count);
+            } else if (key == "radius") {
+                std::string value;
+                in >> value;
+                if (value == "uniform") {
+                    ok = (bool)(in >> current->radius_lo >> current->radius_hi);
+                } else {
+                    current->radius_lo = current->radius_hi = std::atof(value.c_str());
+                    ok = current->radius_lo > 0.0f;
+                }
+            } else if (key == "mass") {
+                ok = (bool)(in >> current->mass);
+            } else if (key == "position") {
+                ok = readDistribution(in, current->position);
+            } else if (key == "velocity") {
+                ok = readDistribution(in, current->velocity);
+            } else if (key == "color") {
+                ok = readDistribution(in, current->color);
+            } else {
+                ok = false;
+            }
+        }
+
+        if (!ok) {
+            std::cout << "ERROR::SCENARIO::PARSE line " << n_line << ": " << line << std::endl;
+            return false;
+        }
+    }
+    if (current != nullptr) {
+        std::cout << "ERROR::SCENARIO::PARSE species " << current->name << " has no end" << std::endl;
+        return false;
+    }
+
+    // Same draws in the same order as long as the text does not change
+    std::srand(scenario.seed);
+    for (std::vector<Species>::iterator s = species.begin(); s != species.end(); ++s) {
+        for (unsigned long i = 0; i != s->count; ++i) {
+            Sphere sphere;
+            sphere.pos = s->position.sample();
+            sphere.vel = s->velocity.sample();
+            sphere.color = s->color.sample();
+            sphere.radius = s->radius_lo == s->radius_hi ? s->radius_lo : glm::linearRand(s->radius_lo, s->radius_hi);
+            sphere.m = s->mass >= 0.0f ? s->mass : M_PI * sphere.radius * sphere.radius;
+            scenario.spheres.push_back(sphere);
+        }
+    }
+    return true;
+}
+
+static bool readCache(const std::string& filename, uint64_t hash, Scenario& scenario) {
+    int fd = ::open(filename.c_str(), O_RDONLY);
+    if (fd < 0)
+        return false;
+    struct stat st;
+    if (::fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(CacheHeader)) {
+        ::close(fd);
+        return false;
+    }
+    void* data = ::mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (data == MAP_FAILED)
+        return false;
+
+    CacheHeader header;
+    std::memcpy(&header, data, sizeof(header));
+    bool ok = std::memcmp(header.magic, CACHE_MAGIC, sizeof(header.magic)) == 0 && header.version == CACHE_VERSION
+           && header.sphere_size == sizeof(Sphere) && header.hash == hash
+           && (size_t)st.st_size >= sizeof(header) + header.n_spheres * sizeof(Sphere);
+    if (ok) {
+        scenario.seed = header.seed;
+        scenario.n_substeps = header.n_substeps;
+        scenario.box_center = header.box_center;
+        scenario.box_size = header.box_size;
+        scenario.ccd_threshold = header.ccd_threshold;
+        const Sphere* first = (const Sphere*)((const char*)data + sizeof(header));
+        scenario.spheres.assign(first, first + header.n_spheres);
+    }
+    ::munmap(data, st.st_size);
+    return ok;
+}
+
+static bool writeCache(const std::string& filename, uint64_t hash, const Scenario& scenario) {
+    CacheHeader header = CacheHeader();
+    std::memcpy(header.magic, CACHE_MAGIC, sizeof(header.magic));
+    header.version = CACHE_VERSION;
+    header.sphere_size = sizeof(Sphere);
+    header.hash = hash;
+    header.n_spheres = scenario.spheres.size();
+    header.seed = scenario.seed;
+    header.n_substeps = scenario.n_substeps;
+    header.box_center = scenario.box_center;
+    header.box_size = scenario.box_size;
+    header.ccd_threshold = scenario.ccd_threshold;
+
+    // Written aside then renamed so a reader never maps a half written cache
+    std::string tmp = filename + ".tmp";
+    std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+    out.write((const char*)&header, sizeof(header));
+    out.write((const char*)scenario.spheres.data(), scenario.spheres.size() * sizeof(Sphere));
+    out.close();
+    if (!out || std::rename(tmp.c_str(), filename.c_str()) != 0) {
+        std::cout << "WARNING::SCENARIO::CACHE_NOT_WRITTEN " << filename << std::endl;
+        std::remove(tmp.c_str());
+        return false;
+    }
+    return true;
+}
+
+bool loadScenario(const std::string& filename, Scenario& scenario) {
+    std::ifstream file(filename, std::ios::binary);
+    if (!file) {
+        std::cout << "ERROR::SCENARIO::FILE_NOT_SUCCESSFULLY_READ " << filename << std::endl;
+        return false;
+    }
+    std::stringstream buffer;
+    buffer << file.rdbuf();
+    std::string text = buffer.str();
+
+    uint64_t hash = fnv1a(&CACHE_VERSION, sizeof(CACHE_VERSION));
+    hash = fnv1a(text.data(), text.size(), hash);
+
+    std::string cache = filename + ".cache";
+    if (readCache(cache, hash, scenario))
+        return true;
+
+    if (!compileScenario(text, scenario))
+        return false;
+    writeCache(cache, hash, scenario);
+    return true;
+}
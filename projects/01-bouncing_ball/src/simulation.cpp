@@ -0,0 +1,123 @@
+#include <glm/glm.hpp>
+
+#include <chrono>
+#include <vector>
+
+#include "simulation.hpp"
+#include "physics.hpp"
+#include "jobs.hpp"
+#include "arena.hpp"
+
+typedef std::chrono::steady_clock Clock;
+
+Simulation::Simulation(): quit(false), rate(0.0), arena_high_water(0) {
+};
+
+Simulation::~Simulation() {
+    stop();
+};
+
+void Simulation::start(const std::vector<Sphere>& spheres, double time) {
+    stop();
+    SimState state;
+    state.spheres = spheres;
+    state.time = time;
+    states.reset(state);
+    quit = false;
+    thread = std::thread(&Simulation::run, this, state);
+};
+
+void Simulation::stop() {
+    if (!thread.joinable())
+        return;
+    quit = true;
+    thread.join();
+};
+
+const SimState& Simulation::latest() {
+    states.update();
+    return states.read();
+};
+
+void Simulation::run(SimState state) {
+    JobSystem& jobs = JobSystem::instance();
+    // Runs onStep on the last published state, created once so that a step allocates nothing
+    const SimState* published = nullptr;
+    JobHandle consumers = jobs.create([this, &published]() { onStep(*published); }, true);
+    bool consuming = false;
+
+    // Wall clock of step `origin_steps`, the next ones are due every dt after it
+    Clock::time_point origin = Clock::now();
+    uint64_t origin_steps = state.steps;
+    Clock::time_point window = origin;
+    uint64_t window_steps = state.steps;
+
+    while (!quit) {
+        if (realtime) {
+            Clock::time_point due = origin + std::chrono::duration_cast<Clock::duration>(
+                std::chrono::duration<double>((state.steps - origin_steps) * (double)dt));
+            Clock::time_point now = Clock::now();
+            if (due > now) {
+                std::this_thread::sleep_until(due);
+            } else if (now - due > std::chrono::milliseconds(250)) {
+                // Too slow for real time: drop the backlog instead of catching up forever
+                origin = now;
+                origin_steps = state.steps;
+            }
+        }
+
+        step(state.spheres);
+        state.time += dt;
+        ++state.steps;
+
+        // The consumers of the previous state may still read the slot about to be written
+        if (consuming)
+            jobs.wait(consumers);
+        consuming = false;
+        SimState& out = states.write();
+        out = state;
+        states.publish();
+
+        // The published slot is only written again after them, so they overlap the next step
+        if (onStep) {
+            published = &out;
+            jobs.reset(consumers);
+            jobs.submit(consumers);
+            consuming = true;
+        }
+
+        Clock::time_point now = Clock::now();
+        if (now - window >= std::chrono::seconds(1)) {
+            rate = (state.steps - window_steps) / std::chrono::duration<double>(now - window).count();
+            window = now;
+            window_steps = state.steps;
+        }
+    }
+    if (consuming)
+        jobs.wait(consumers);
+};
+
+void Simulation::step(std::vector<Sphere>& spheres) {
+    // Nothing of the previous step is alive any more
+    Arena& arena = frameArena();
+    arena.reset();
+
+    // Create substeps for stability
+    float sub_dt = dt / n_substeps;
+    for (std::vector<Sphere>::iterator it = spheres.begin(); it != spheres.end(); ++it) {
+        for (unsigned int step = 0; step != n_substeps; ++step) {
+            // Move the ball i.e. update position and speed, fast balls are swept so they cannot tunnel
+            if (isFast(*it, sub_dt, ccd_threshold))
+                moveSwept(spheres, it - spheres.begin(), sub_dt, centerBox, halfBox);
+            else
+                move(*it, sub_dt, centerBox, halfBox);
+
+            // Check for collisions
+            for (std::vector<Sphere>::iterator it2 = spheres.begin(); it2 != spheres.end(); ++it2) {
+                if (it != it2)
+                    collision(*it, *it2);
+            }
+        }
+    }
+    arena_high_water = arena.highWater();
+};
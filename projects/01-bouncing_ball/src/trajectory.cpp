@@ -0,0 +1,239 @@
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+#include "trajectory.hpp"
+#include "codec.hpp"
+
+
+uint32_t frameColumns(uint32_t schema) {
+    return ((schema & SCHEMA_POS) ? 3 : 0) + ((schema & SCHEMA_VEL) ? 3 : 0);
+}
+
+uint64_t frameBytes(uint32_t schema, uint64_t n_particles) {
+    return sizeof(double) + frameColumns(schema) * n_particles * sizeof(float);
+}
+
+bool validChunk(const TrajectoryHeader& header, const ChunkInfo& info, uint64_t file_bytes) {
+    // Written as differences so that a damaged entry cannot overflow
+    if (info.offset > file_bytes || info.bytes > file_bytes - info.offset)
+        return false;
+    if (info.first_frame > header.n_frames || info.n_frames > header.n_frames - info.first_frame)
+        return false;
+    if (info.n_frames > header.steps_per_chunk)
+        return false;
+    if (info.flags & CHUNK_COMPRESSED)
+        return true;
+    uint64_t frame_bytes = frameBytes(header.schema, header.n_particles);
+    return info.bytes % frame_bytes == 0 && info.bytes / frame_bytes == info.n_frames;
+}
+
+
+TrajectoryRecorder::TrajectoryRecorder(): frame_bytes(0), offset(0), stall(0.0), current(nullptr), stop(false) {
+    header = TrajectoryHeader();
+};
+
+TrajectoryRecorder::~TrajectoryRecorder() {
+    close();
+};
+
+bool TrajectoryRecorder::open(const std::string& filename, const std::vector<Sphere>& spheres, float dt,
+                              uint32_t schema, uint64_t chunk_bytes) {
+    close();
+
+    uint64_t n = spheres.size();
+    frame_bytes = frameBytes(schema, n);
+
+    header = TrajectoryHeader();
+    std::memcpy(header.magic, TRAJECTORY_MAGIC, sizeof(header.magic));
+    header.version = TRAJECTORY_VERSION;
+    header.schema = schema;
+    header.n_particles = n;
+    header.dt = dt;
+    header.steps_per_chunk = (uint32_t)std::max<uint64_t>(1, chunk_bytes / frame_bytes);
+    header.static_offset = TRAJECTORY_BLOCK;
+    bool compressed = (schema & SCHEMA_COMPRESSED) != 0;
+    if (compressed)
+        setupCodec(header, codec);
+
+    // Raw chunks are filled in place in the writer buffers, coded ones are coded into them.
+    // Compression is the bottleneck of the latter: fewer writes in flight are enough.
+    uint64_t raw_bytes = alignBlock(header.steps_per_chunk * frame_bytes);
+    uint64_t buffer_bytes = compressed ? alignBlock(compressedBound(header, header.steps_per_chunk)) : raw_bytes;
+    buffer_bytes = std::max(buffer_bytes, alignBlock(4 * n * sizeof(float)));
+    if (!output.open(filename, compressed ? 4 : 8, buffer_bytes)) {
+        std::cout << "ERROR::TRAJECTORY::FILE_NOT_SUCCESSFULLY_OPENED " << filename << std::endl;
+        return false;
+    }
+
+    // Static block: radius then color, one column each
+    std::vector<float> statics(4 * n);
+    for (uint64_t i = 0; i != n; ++i) {
+        statics[i] = spheres[i].radius;
+        statics[n + i] = spheres[i].color.r;
+        statics[2 * n + i] = spheres[i].color.g;
+        statics[3 * n + i] = spheres[i].color.b;
+    }
+    writeBlock(statics.data(), statics.size() * sizeof(float), header.static_offset);
+    offset = header.static_offset + alignBlock(statics.size() * sizeof(float));
+    stall = 0.0;
+    index.clear();
+    current = nullptr;
+
+    if (compressed) {
+        for (int i = 0; i != N_BUFFERS; ++i) {
+            buffers[i].data = (unsigned char*)std::aligned_alloc(TRAJECTORY_BLOCK, raw_bytes);
+            buffers[i].n_frames = 0;
+            spare.push_back(&buffers[i]);
+        }
+        stop = false;
+        encoder = std::thread(&TrajectoryRecorder::encode, this);
+    }
+    return true;
+};
+
+void TrajectoryRecorder::record(const std::vector<Sphere>& spheres, double time) {
+    if (!isOpen() || spheres.size() != header.n_particles)
+        return;
+
+    if (current == nullptr) {
+        if (header.schema & SCHEMA_COMPRESSED) {
+            std::unique_lock<std::mutex> lock(mutex);
+            if (spare.empty()) {
+                auto start = std::chrono::steady_clock::now();
+                cv.wait(lock, [&]() { return !spare.empty(); });
+                stall += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            }
+            current = spare.front();
+            spare.pop_front();
+        } else {
+            // Waits inside acquire() when every buffer is still being written
+            raw.output = output.acquire();
+            raw.data = output.data(raw.output);
+            current = &raw;
+        }
+        current->first_frame = header.n_frames;
+        current->n_frames = 0;
+    }
+
+    // Scatter the spheres into columns
+    uint64_t n = header.n_particles;
+    unsigned char* frame = current->data + current->n_frames * frame_bytes;
+    std::memcpy(frame, &time, sizeof(double));
+    float* column = (float*)(frame + sizeof(double));
+    if (header.schema & SCHEMA_POS) {
+        for (uint64_t i = 0; i != n; ++i) {
+            column[i] = spheres[i].pos.x;
+            column[n + i] = spheres[i].pos.y;
+            column[2 * n + i] = spheres[i].pos.z;
+        }
+        column += 3 * n;
+    }
+    if (header.schema & SCHEMA_VEL) {
+        for (uint64_t i = 0; i != n; ++i) {
+            column[i] = spheres[i].vel.x;
+            column[n + i] = spheres[i].vel.y;
+            column[2 * n + i] = spheres[i].vel.z;
+        }
+    }
+
+    ++current->n_frames;
+    ++header.n_frames;
+    if (current->n_frames == header.steps_per_chunk)
+        submit();
+};
+
+void TrajectoryRecorder::submit() {
+    if (header.schema & SCHEMA_COMPRESSED) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            pending.push_back(current);
+        }
+        cv.notify_all();
+    } else {
+        writeChunk(current->output, current->n_frames * frame_bytes, *current, 0);
+    }
+    current = nullptr;
+};
+
+void TrajectoryRecorder::encode() {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        cv.wait(lock, [&]() { return stop || !pending.empty(); });
+        if (pending.empty())
+            return;
+        Buffer* buffer = pending.front();
+        pending.pop_front();
+        lock.unlock();
+
+        int out = output.acquire();
+        uint64_t bytes = encodeChunk(header, buffer->data, buffer->n_frames, output.data(out));
+        writeChunk(out, bytes, *buffer, CHUNK_COMPRESSED);
+
+        lock.lock();
+        spare.push_back(buffer);
+        cv.notify_all();
+    }
+};
+
+// Chunks are written in order by a single thread (the caller of record(), or the encoder),
+// it is the only one to touch offset and index
+void TrajectoryRecorder::writeChunk(int buffer, uint64_t bytes, const Buffer& frames, uint32_t flags) {
+    ChunkInfo info = {offset, bytes, frames.first_frame, frames.n_frames, flags};
+    // The padding up to the block goes to disk too: zeros, not what the buffer held before
+    std::memset(output.data(buffer) + bytes, 0, alignBlock(bytes) - bytes);
+    output.submit(buffer, alignBlock(bytes), offset);
+    index.push_back(info);
+    offset += alignBlock(bytes);
+};
+
+void TrajectoryRecorder::writeBlock(const void* data, uint64_t bytes, uint64_t at) {
+    const unsigned char* p = (const unsigned char*)data;
+    while (bytes != 0) {
+        uint64_t part = std::min(bytes, output.bufferBytes());
+        int buffer = output.acquire();
+        std::memset(output.data(buffer), 0, alignBlock(part));
+        std::memcpy(output.data(buffer), p, part);
+        output.submit(buffer, alignBlock(part), at);
+        p += part;
+        at += part;
+        bytes -= part;
+    }
+};
+
+void TrajectoryRecorder::close() {
+    if (!isOpen())
+        return;
+
+    if (current != nullptr && current->n_frames != 0)
+        submit();
+    if (encoder.joinable()) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stop = true;
+        }
+        cv.notify_all();
+        encoder.join();
+    }
+
+    // Index after the last chunk, then the header now that everything is known
+    header.n_chunks = index.size();
+    header.index_offset = offset;
+    writeBlock(index.data(), index.size() * sizeof(ChunkInfo), header.index_offset);
+    writeBlock(&header, sizeof(header), 0);
+    if (!output.close())
+        std::cout << "ERROR::TRAJECTORY::INCOMPLETE " << header.n_frames << " frames" << std::endl;
+
+    for (int i = 0; i != N_BUFFERS; ++i) {
+        std::free(buffers[i].data);
+        buffers[i].data = nullptr;
+    }
+    pending.clear();
+    spare.clear();
+    current = nullptr;
+};
@@ -0,0 +1,215 @@
+#include <glm/glm.hpp>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "vtk_export.hpp"
+#include "trajectory.hpp"
+#include "codec.hpp"
+#include "parallel.hpp"
+
+static std::string stepFile(const std::string& prefix, uint64_t frame) {
+    char number[32];
+    std::snprintf(number, sizeof(number), "_%06llu.vtp", (unsigned long long)frame);
+    return prefix + number;
+}
+
+// Appended block: the byte count (header_type UInt64) then the raw values
+static void writeArray(std::ofstream& out, const float* data, uint64_t n_values) {
+    uint64_t bytes = n_values * sizeof(float);
+    out.write((const char*)&bytes, sizeof(bytes));
+    out.write((const char*)data, bytes);
+}
+
+static bool writeStep(const std::string& filename, const TrajectoryHeader& header, const unsigned char* frame,
+                      const std::vector<float>& statics, std::vector<float>& scratch) {
+    uint64_t n = header.n_particles;
+    const float* column = (const float*)(frame + sizeof(double));
+    const float* pos = (header.schema & SCHEMA_POS) ? column : nullptr;
+    const float* vel = (header.schema & SCHEMA_VEL) ? column + (pos ? 3 * n : 0) : nullptr;
+
+    // Offsets of the arrays in the appended data, each one is preceded by its size
+    uint64_t vector = sizeof(uint64_t) + 3 * n * sizeof(float);
+    uint64_t scalar = sizeof(uint64_t) + n * sizeof(float);
+    uint64_t velocity_offset = vector;
+    uint64_t radius_offset = velocity_offset + (vel ? vector : 0);
+    uint64_t color_offset = radius_offset + scalar;
+
+    std::ostringstream xml;
+    xml << "<?xml version=\"1.0\"?>\n"
+        << "<VTKFile type=\"PolyData\" version=\"1.0\" byte_order=\"LittleEndian\" header_type=\"UInt64\">\n"
+        << "  <PolyData>\n"
+        << "    <Piece NumberOfPoints=\"" << n << "\" NumberOfVerts=\"0\" NumberOfLines=\"0\" NumberOfStrips=\"0\" NumberOfPolys=\"0\">\n"
+        << "      <Points>\n"
+        << "        <DataArray type=\"Float32\" NumberOfComponents=\"3\" format=\"appended\" offset=\"0\"/>\n"
+        << "      </Points>\n"
+        << "      <PointData Scalars=\"radius\"" << (vel ? " Vectors=\"velocity\"" : "") << ">\n";
+    if (vel)
+        xml << "        <DataArray type=\"Float32\" Name=\"velocity\" NumberOfComponents=\"3\" format=\"appended\" offset=\"" << velocity_offset << "\"/>\n";
+    xml << "        <DataArray type=\"Float32\" Name=\"radius\" format=\"appended\" offset=\"" << radius_offset << "\"/>\n"
+        << "        <DataArray type=\"Float32\" Name=\"color\" NumberOfComponents=\"3\" format=\"appended\" offset=\"" << color_offset << "\"/>\n"
+        << "      </PointData>\n"
+        << "    </Piece>\n"
+        << "  </PolyData>\n"
+        << "  <AppendedData encoding=\"raw\">\n"
+        << "   _";
+
+    std::ofstream out(filename, std::ios::binary | std::ios::trunc);
+    if (!out) {
+        std::cout << "ERROR::VTK_EXPORT::FILE_NOT_SUCCESSFULLY_OPENED " << filename << std::endl;
+        return false;
+    }
+    std::string text = xml.str();
+    out.write(text.data(), text.size());
+
+    // VTK wants the components interleaved, the recording has them in columns
+    scratch.resize(3 * n);
+    auto interleave = [&](const float* x, const float* y, const float* z) {
+        for (uint64_t i = 0; i != n; ++i) {
+            scratch[3 * i] = x[i];
+            scratch[3 * i + 1] = y[i];
+            scratch[3 * i + 2] = z[i];
+        }
+        writeArray(out, scratch.data(), 3 * n);
+    };
+    if (pos) {
+        interleave(pos, pos + n, pos + 2 * n);
+    } else {
+        std::fill(scratch.begin(), scratch.end(), 0.0f);
+        writeArray(out, scratch.data(), 3 * n);
+    }
+    if (vel)
+        interleave(vel, vel + n, vel + 2 * n);
+    writeArray(out, statics.data(), n);
+    interleave(statics.data() + n, statics.data() + 2 * n, statics.data() + 3 * n);
+
+    const char* end = "\n  </AppendedData>\n</VTKFile>\n";
+    out.write(end, std::strlen(end));
+    out.close();
+    if (!out) {
+        std::cout << "ERROR::VTK_EXPORT::WRITE_FAILED " << filename << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool exportVTK(const std::string& trajectory, const std::string& prefix, uint64_t stride) {
+    stride = std::max<uint64_t>(stride, 1);
+
+    int fd = ::open(trajectory.c_str(), O_RDONLY);
+    if (fd < 0) {
+        std::cout << "ERROR::VTK_EXPORT::FILE_NOT_SUCCESSFULLY_OPENED " << trajectory << std::endl;
+        return false;
+    }
+    struct stat st;
+    if (::fstat(fd, &st) != 0 || (uint64_t)st.st_size < TRAJECTORY_BLOCK) {
+        std::cout << "ERROR::VTK_EXPORT::NOT_A_TRAJECTORY " << trajectory << std::endl;
+        ::close(fd);
+        return false;
+    }
+    uint64_t bytes = st.st_size;
+    void* data = ::mmap(nullptr, bytes, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (data == MAP_FAILED) {
+        std::cout << "ERROR::VTK_EXPORT::MMAP_FAILED " << trajectory << std::endl;
+        return false;
+    }
+    const unsigned char* map = (const unsigned char*)data;
+    ::madvise(data, bytes, MADV_SEQUENTIAL);
+
+    TrajectoryHeader header;
+    std::memcpy(&header, map, sizeof(header));
+    uint64_t n = header.n_particles;
+    // Written as differences so that a damaged header cannot overflow
+    bool ok = std::memcmp(header.magic, TRAJECTORY_MAGIC, sizeof(header.magic)) == 0 && header.version <= TRAJECTORY_VERSION
+           && header.index_offset <= bytes && header.n_chunks <= (bytes - header.index_offset) / sizeof(ChunkInfo)
+           && header.static_offset <= bytes && n <= (bytes - header.static_offset) / (4 * sizeof(float));
+    if (!ok) {
+        std::cout << "ERROR::VTK_EXPORT::NOT_A_TRAJECTORY " << trajectory << std::endl;
+        ::munmap(data, bytes);
+        return false;
+    }
+    const ChunkInfo* index = (const ChunkInfo*)(map + header.index_offset);
+    const float* s = (const float*)(map + header.static_offset);
+    std::vector<float> statics(s, s + 4 * n);
+    uint64_t frame_bytes = frameBytes(header.schema, n);
+
+    // Chunks in parallel, each worker decodes its chunk and writes the steps it holds. Only the
+    // steps written go to the collection, a corrupt chunk leaves its steps out.
+    struct Step {
+        uint64_t frame;
+        double time;
+    };
+    std::vector<std::vector<Step>> written(header.n_chunks);
+    std::atomic<bool> success(true);
+    parallel_for(0, header.n_chunks, 1, [&](size_t begin, size_t end) {
+        std::vector<unsigned char> decoded;
+        std::vector<float> scratch;
+        for (size_t c = begin; c != end; ++c) {
+            const ChunkInfo& info = index[c];
+            if (!validChunk(header, info, bytes)) {
+                std::cout << "ERROR::VTK_EXPORT::CORRUPT_CHUNK " << c << std::endl;
+                success = false;
+                continue;
+            }
+            // Skip chunks without any exported step
+            uint64_t first = (info.first_frame + stride - 1) / stride * stride;
+            if (first >= info.first_frame + info.n_frames)
+                continue;
+
+            const unsigned char* frames = map + info.offset;
+            if (info.flags & CHUNK_COMPRESSED) {
+                decoded.resize(info.n_frames * frame_bytes);
+                if (!decodeChunk(header, frames, info.bytes, info.n_frames, decoded.data())) {
+                    std::cout << "ERROR::VTK_EXPORT::CORRUPT_CHUNK " << c << std::endl;
+                    success = false;
+                    continue;
+                }
+                frames = decoded.data();
+            }
+            for (uint64_t f = first; f < info.first_frame + info.n_frames; f += stride) {
+                const unsigned char* frame = frames + (f - info.first_frame) * frame_bytes;
+                double time;
+                std::memcpy(&time, frame, sizeof(double));
+                if (writeStep(stepFile(prefix, f), header, frame, statics, scratch))
+                    written[c].push_back({f, time});
+                else
+                    success = false;
+            }
+        }
+    });
+    ::munmap(data, bytes);
+
+    // Collection, the step files are referenced relative to it
+    std::ofstream pvd(prefix + ".pvd", std::ios::trunc);
+    pvd << "<?xml version=\"1.0\"?>\n"
+        << "<VTKFile type=\"Collection\" version=\"0.1\" byte_order=\"LittleEndian\">\n"
+        << "  <Collection>\n";
+    pvd.precision(17);
+    for (std::vector<std::vector<Step>>::const_iterator chunk = written.begin(); chunk != written.end(); ++chunk) {
+        for (std::vector<Step>::const_iterator it = chunk->begin(); it != chunk->end(); ++it) {
+            pvd << "    <DataSet timestep=\"" << it->time << "\" group=\"\" part=\"0\" file=\""
+                << std::filesystem::path(stepFile(prefix, it->frame)).filename().string() << "\"/>\n";
+        }
+    }
+    pvd << "  </Collection>\n"
+        << "</VTKFile>\n";
+    pvd.close();
+    if (!pvd) {
+        std::cout << "ERROR::VTK_EXPORT::WRITE_FAILED " << prefix << ".pvd" << std::endl;
+        return false;
+    }
+    return success;
+}
@@ -0,0 +1,64 @@
+#ifndef CHECKPOINT_HPP
+#define CHECKPOINT_HPP
+
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <glm/glm.hpp>
+
+#include "object.hpp"
+
+// Everything of the run that is not a sphere. The file is this header followed by the
+// spheres exactly as they are in memory, so restoring is a mmap and a memcpy.
+struct Checkpoint {
+    char magic[8];
+    uint32_t version;
+    uint32_t sphere_size;       // sizeof(Sphere) of the writer, refused if it does not match
+    uint64_t n_spheres;
+    double time;
+    uint32_t seed;              // std::rand seed the scene was generated with
+    uint32_t n_substeps;
+
+    // camera
+    glm::vec3 position;
+    float yaw;
+    float pitch;
+    float zoom;
+};
+
+Checkpoint makeCheckpoint(uint64_t n_spheres, double time, uint32_t seed, uint32_t n_substeps);
+
+// Written to filename.tmp then renamed: a crash during the save keeps the previous checkpoint
+bool saveCheckpoint(const std::string& filename, const Checkpoint& header, const std::vector<Sphere>& spheres);
+bool loadCheckpoint(const std::string& filename, Checkpoint& header, std::vector<Sphere>& spheres);
+
+// Saves every `interval` seconds of sim time on a background thread.
+// update() only copies the spheres when a save is due and the previous one is done.
+class Autosave {
+    public:
+        Autosave(const std::string& filename, double interval = 60.0);
+        ~Autosave();
+
+        void update(const Checkpoint& header, const std::vector<Sphere>& spheres);
+
+    private:
+        std::string filename;
+        double interval;
+        double last;
+
+        Checkpoint header;
+        std::vector<Sphere> snapshot;
+        bool busy;
+        bool stop;
+
+        std::thread writer;
+        std::mutex mutex;
+        std::condition_variable cv;
+
+        void write();
+};
+
+#endif
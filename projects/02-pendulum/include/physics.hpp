@@ -4,7 +4,8 @@
 #include <glm/glm.hpp>
 #include "object.hpp"
 
-float energy(glm::vec3 pos, glm::vec3 v);
+// Kinetic plus potential energy of the sphere (zero potential at y = 0)
+float energy(const Sphere& s);
 void collision(Sphere& s1, Sphere& s2);
 void move(Sphere& s, float dt, glm::vec3 center, float r);
 
@@ -5,8 +5,10 @@
 #include <glm/gtc/type_ptr.hpp>
 #include <glm/gtc/random.hpp>
 
+#include <cstdlib>
 #include <filesystem>
 #include <iostream>
+#include <memory>
 #include <string.h>
 #include <math.h>
 #include <vector>
@@ -17,6 +19,7 @@
 #include "object.hpp"
 #include "setupGL.hpp"
 #include "physics.hpp"
+#include "checkpoint.hpp"
 
 
 const unsigned int SCR_WIDTH = 1920;
@@ -44,6 +47,21 @@ void print(glm::vec3 v){
 
 int main(int argc, char** argv)
 {
+    // --restore <file>: start from a checkpoint
+    // --autosave <file> [seconds]: checkpoint periodically and on exit
+    std::string restore_file, autosave_file;
+    double autosave_interval = 60.0;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg(argv[i]);
+        if (arg == "--restore" && i + 1 < argc)
+            restore_file = argv[++i];
+        else if (arg == "--autosave" && i + 1 < argc) {
+            autosave_file = argv[++i];
+            if (i + 1 < argc && argv[i + 1][0] != '-')
+                autosave_interval = std::atof(argv[++i]);
+        }
+    }
+
     std::string title = "PhysicsSim";
     unsigned int width = 1920;
     unsigned int height = 1080;
@@ -69,6 +87,10 @@ int main(int argc, char** argv)
     axle.color = glm::vec3(1.0f, 0.5f, 0.31f);
 
 
+    // glm::linearRand draws from std::rand
+    unsigned int seed = 1;
+    std::srand(seed);
+
     Sphere sphere;
     sphere.pos = glm::normalize(glm::vec3(0.7f, 0.7f, 0.0f));
     sphere.vel = glm::vec3(-1.0f, -1.0f, 1.0f);
@@ -84,6 +106,37 @@ int main(int argc, char** argv)
     glEnable(GL_DEPTH_TEST);
     unsigned int n_substeps = 100;
 
+    // Sim time, carried over by checkpoints
+    double sim_time = 0.0;
+    if (!restore_file.empty()) {
+        Checkpoint checkpoint;
+        std::vector<Sphere> spheres;
+        if (loadCheckpoint(restore_file, checkpoint, spheres) && spheres.size() == 1) {
+            sphere = spheres[0];
+            seed = checkpoint.seed;
+            n_substeps = checkpoint.n_substeps;
+            sim_time = checkpoint.time;
+            camera = Camera(checkpoint.position, glm::vec3(0.0f, 1.0f, 0.0f), checkpoint.yaw, checkpoint.pitch);
+            camera.Zoom = checkpoint.zoom;
+            // The light keeps turning from where it was
+            glfwSetTime(sim_time);
+            lastFrame = sim_time;
+        }
+    }
+    std::unique_ptr<Autosave> autosave;
+    if (!autosave_file.empty())
+        autosave.reset(new Autosave(autosave_file, autosave_interval));
+    // The state handed to the autosave each frame, allocated once
+    std::vector<Sphere> saved(1, sphere);
+    auto checkpoint = [&]() {
+        Checkpoint c = makeCheckpoint(1, sim_time, seed, n_substeps);
+        c.position = camera.Position;
+        c.yaw = camera.Yaw;
+        c.pitch = camera.Pitch;
+        c.zoom = camera.Zoom;
+        return c;
+    };
+
     glm::vec3 center(0.0f, 0.0f, 0.0f);
     float radius = 1.0f;
 
@@ -94,6 +147,7 @@ int main(int argc, char** argv)
         float time = glfwGetTime();
         deltaTime = time - lastFrame;
         lastFrame = time;
+        sim_time += deltaTime;
 
         // Time for frame
         std::streamsize prec = std::cout.precision();
@@ -175,12 +229,24 @@ int main(int argc, char** argv)
         lightShader.setMat4f("view", view);
         mesh_cube.Draw();
 
+        if (autosave) {
+            saved[0] = sphere;
+            autosave->update(checkpoint(), saved);
+        }
+
         // swap buffers and poll IO events (key pressed/released, ...)
         // -----------------------------------------------------------
         glfwSwapBuffers(window);
         glfwPollEvents();
     }
 
+    if (autosave) {
+        // Waits for a save still running, the final one must not be overwritten
+        autosave.reset();
+        saved[0] = sphere;
+        saveCheckpoint(autosave_file, checkpoint(), saved);
+    }
+
     // glfw: terminate, clear all previous allocated GLFW resources
     // ------------------------------------------------------------
     glfwDestroyWindow(window);
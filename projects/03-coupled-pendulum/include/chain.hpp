@@ -0,0 +1,112 @@
+#ifndef CHAIN_HPP
+#define CHAIN_HPP
+
+#include <array>
+#include <utility>
+#include <vector>
+#include <glm/glm.hpp>
+
+#include "object.hpp"
+
+// Calls f(std::integral_constant<int, I>) for I = 0..N-1, expanded at compile time
+template<typename F, int... I>
+inline void unroll(F&& f, std::integer_sequence<int, I...>) {
+    (f(std::integral_constant<int, I>()), ...);
+}
+template<int N, typename F>
+inline void unroll(F&& f) {
+    unroll(f, std::make_integer_sequence<int, N>());
+}
+
+// Pendulum chain with a link count known at compile time.
+// Does exactly what step() with a GAUSS_SEIDEL ConstraintSolver does on a chain (the coloring
+// puts even rods in color 0 and odd rods in color 1), but every loop is unrolled and the
+// state lives in std::arrays instead of a vector of Sphere.
+template<int N>
+class Chain {
+    public:
+        std::array<glm::vec3, N> pos;
+        std::array<glm::vec3, N> prev_pos;
+        std::array<glm::vec3, N> vel;
+        glm::vec3 anchor;
+        float length;
+
+        Chain(glm::vec3 anchor, float length): anchor(anchor), length(length) {};
+
+        void load(const std::vector<Sphere>& spheres) {
+            unroll<N>([&](auto i) {
+                pos[i] = spheres[i].pos;
+                prev_pos[i] = spheres[i].prev_pos;
+                vel[i] = spheres[i].vel;
+            });
+
+            // Share of each rod correction taken by its two ends, from the inverse masses.
+            // Same expressions as project() in constraint.cpp so results are bit identical.
+            unroll<N>([&](auto i) {
+                float wa = 0.0f;
+                if constexpr (i != 0)
+                    wa = 1.0f / spheres[i - 1].m;
+                float wb = 1.0f / spheres[i].m;
+                ka[i] = wa / (wa + wb);
+                kb[i] = wb / (wa + wb);
+                valid[i] = wa + wb != 0.0f;
+            });
+        };
+
+        void store(std::vector<Sphere>& spheres) const {
+            unroll<N>([&](auto i) {
+                spheres[i].pos = pos[i];
+                spheres[i].prev_pos = prev_pos[i];
+                spheres[i].vel = vel[i];
+            });
+        };
+
+        void step(float dt) {
+            glm::vec3 g(0.0f, -10.f, 0.0f);
+
+            // Move the particles
+            unroll<N>([&](auto i) {
+                prev_pos[i] = pos[i];
+                vel[i] += g * dt;
+                pos[i] += vel[i] * dt;
+            });
+
+            // Solve constraints: rod i links sphere i-1 (or the anchor) to sphere i
+            unroll<(N + 1) / 2>([&](auto k) { project<2 * k>(); });
+            unroll<N / 2>([&](auto k) { project<2 * k + 1>(); });
+
+            // Update velocities
+            unroll<N>([&](auto i) {
+                vel[i] = (pos[i] - prev_pos[i]) / dt;
+            });
+        };
+
+    private:
+        std::array<float, N> ka;
+        std::array<float, N> kb;
+        std::array<bool, N> valid;
+
+        template<int I>
+        void project() {
+            glm::vec3 pa = anchor;
+            if constexpr (I != 0)
+                pa = pos[I - 1];
+
+            glm::vec3 diff = pos[I] - pa;
+            float d = glm::length(diff);
+            if (d == 0.0f || !valid[I])
+                return;
+
+            glm::vec3 n = diff / d;
+            float C = d - length;
+            if constexpr (I != 0)
+                pos[I - 1] += ka[I] * C * n;
+            pos[I] += -kb[I] * C * n;
+        };
+};
+
+// Runs n_steps substeps of the chain through Chain<spheres.size()>, specialized for 2 to 8 links.
+// Returns false, leaving spheres untouched, for any other size.
+bool stepChain(std::vector<Sphere>& spheres, glm::vec3 anchor, float length, float dt, unsigned long n_steps = 1);
+
+#endif
@@ -0,0 +1,61 @@
+#ifndef CONSTRAINT_HPP
+#define CONSTRAINT_HPP
+
+#include <vector>
+#include <glm/glm.hpp>
+
+#include "object.hpp"
+
+// Keeps spheres a and b at a fixed distance.
+// A negative a ties b to the fixed point `anchor` instead (e.g. the pendulum pivot).
+struct DistanceConstraint {
+    int a;
+    int b;
+    float length;
+    glm::vec3 anchor;
+};
+
+enum Solver_Mode {
+    GAUSS_SEIDEL,   // colored: constraints of one color share no sphere and are projected in parallel
+    JACOBI          // every constraint reads the same state, corrections are averaged per sphere
+};
+
+// Position based solver for networks of distance constraints (chains, ropes, cloth).
+// The constraint graph is greedily colored once, so each color can be solved with all cores.
+class ConstraintSolver {
+    public:
+        ConstraintSolver(Solver_Mode mode = GAUSS_SEIDEL, unsigned int iterations = 1);
+
+        Solver_Mode mode;
+        unsigned int iterations;
+        // over-relaxation of the averaged jacobi corrections, 1 is plain averaging
+        float omega;
+
+        void add(const DistanceConstraint& c);
+        void clear();
+        void solve(std::vector<Sphere>& spheres);
+
+        unsigned int nColors() const { return colorStart.empty() ? 0 : colorStart.size() - 1; };
+        size_t size() const { return constraints.size(); };
+
+    private:
+        std::vector<DistanceConstraint> constraints;
+        // constraints[colorStart[c], colorStart[c+1]) have color c
+        std::vector<unsigned int> colorStart;
+        size_t n_spheres;
+        bool dirty;
+
+        // sphere -> constraints touching it (CSR), used to gather jacobi corrections
+        std::vector<unsigned int> adjStart;
+        std::vector<unsigned int> adjacency;
+        std::vector<glm::vec3> corrections;
+
+        void build(size_t n);
+        void solveColored(std::vector<Sphere>& spheres);
+        void solveJacobi(std::vector<Sphere>& spheres);
+};
+
+// Rods of a pendulum chain: sphere 0 hangs from anchor, each next one from the previous
+void addChain(ConstraintSolver& solver, int n, glm::vec3 anchor, float length);
+
+#endif
@@ -0,0 +1,81 @@
+#ifndef JOBS_HPP
+#define JOBS_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+inline unsigned int hardwareThreads() {
+    unsigned int n = std::thread::hardware_concurrency();
+    return n == 0 ? 1 : n;
+}
+
+struct Job;
+typedef std::shared_ptr<Job> JobHandle;
+
+struct Job {
+    std::function<void()> task;
+    std::atomic<int> pending;           // dependencies not done yet, plus one until submitted
+    std::atomic<bool> done;
+    std::mutex mutex;                   // guards next
+    std::vector<JobHandle> next;        // jobs waiting for this one
+};
+
+// Work-stealing scheduler. Each worker owns a deque: it pushes and pops its own jobs at the back
+// (last in first out, their data is still in cache) while idle workers steal at the front, where
+// the oldest and so largest pieces of a split range are. Threads that are not workers (main, ...)
+// share one more deque and run jobs while they wait, so jobs can wait on jobs.
+// Idle workers spin a little, then yield, then sleep until something is pushed.
+class JobSystem {
+    public:
+        explicit JobSystem(unsigned int n_workers);
+        ~JobSystem();
+
+        // Shared by the whole program, one worker per core besides the caller, started on first use
+        static JobSystem& instance();
+
+        unsigned int workers() const { return threads.size(); };
+
+        JobHandle create(std::function<void()> task);
+        // job will not start before dependency is done. Call it before job is submitted.
+        void depend(const JobHandle& job, const JobHandle& dependency);
+        // The job runs once its dependencies are done
+        void submit(const JobHandle& job);
+        // Runs other jobs until job is done
+        void wait(const JobHandle& job);
+
+        // Calls f(begin, end) on pieces of at most grain elements and returns when they are all
+        // done. The range is halved on grain boundaries, the caller keeps splitting the first half
+        // and pushes the second one for the thieves.
+        void parallel_for(size_t begin, size_t end, size_t grain, const std::function<void(size_t, size_t)>& f);
+
+    private:
+        struct Queue {
+            std::mutex mutex;
+            std::deque<JobHandle> jobs;
+        };
+
+        std::vector<std::thread> threads;
+        std::unique_ptr<Queue[]> queues;        // 0 is shared by the other threads, then one per worker
+        std::atomic<int> queued;
+        std::atomic<bool> stop;
+
+        std::mutex sleep_mutex;
+        std::condition_variable sleep_cv;
+        std::atomic<int> sleeping;
+
+        unsigned int index() const;
+        void push(const JobHandle& job);
+        JobHandle pop();
+        bool runOne();
+        void execute(const JobHandle& job);
+        void work(unsigned int index);
+};
+
+#endif
@@ -0,0 +1,37 @@
+#ifndef LYAPUNOV_HPP
+#define LYAPUNOV_HPP
+
+#include <string>
+#include <vector>
+#include <glm/glm.hpp>
+
+#include "object.hpp"
+
+struct LyapunovSettings {
+    float dt = 1.0f / 6000.0f;          // same substep as the viewer at 60 fps with 100 substeps
+    unsigned long n_steps = 600000;     // 100 s of simulated time
+    unsigned int renorm_every = 100;    // steps between two renormalizations of the shadow
+    float d0 = 1e-3f;                   // separation kept between system and shadow, smaller drowns in float noise
+    float rod_length = 1.0f;
+    glm::vec3 center = glm::vec3(0.0f);
+};
+
+struct LyapunovResult {
+    float exponent;                     // largest Lyapunov exponent, in 1/s
+    float divergence;                   // mean log(d/d0) per renormalization
+    unsigned long n_renorm;
+};
+
+// Evolves the chain next to a shadow copy perturbed by d0.
+// Every renorm_every steps the position separation d is measured, log(d/d0) is accumulated and the
+// shadow (positions and velocities) is pulled back to distance d0 along the same direction,
+// so no trajectory is stored.
+LyapunovResult lyapunov(const std::vector<Sphere>& initial, const LyapunovSettings& settings);
+
+// One independent run per initial condition, spread over all the cores
+std::vector<LyapunovResult> lyapunov(const std::vector<std::vector<Sphere>>& initials, const LyapunovSettings& settings);
+
+// One line per initial condition: index, exponent, divergence, n_renorm
+bool writeLyapunov(const std::string& path, const std::vector<LyapunovResult>& results, const LyapunovSettings& settings);
+
+#endif
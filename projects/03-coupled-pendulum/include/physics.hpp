@@ -2,10 +2,15 @@
 #define PHYSICS_HPP
 
 #include <glm/glm.hpp>
+#include <vector>
 #include "object.hpp"
+#include "constraint.hpp"
 
-float energy(glm::vec3 pos, glm::vec3 v);
+// Kinetic plus potential energy of the sphere (zero potential at y = 0)
+float energy(const Sphere& s);
 void collision(Sphere& s1, Sphere& s2);
 void move(Sphere& s, float dt);
+// One substep of the constrained system: move, solve constraints, update velocities
+void step(std::vector<Sphere>& spheres, ConstraintSolver& solver, float dt);
 
 #endif
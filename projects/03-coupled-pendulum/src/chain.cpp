@@ -0,0 +1,27 @@
+#include <glm/glm.hpp>
+
+#include <vector>
+
+#include "chain.hpp"
+
+template<int N>
+static void run(std::vector<Sphere>& spheres, glm::vec3 anchor, float length, float dt, unsigned long n_steps) {
+    Chain<N> chain(anchor, length);
+    chain.load(spheres);
+    for (unsigned long n = 0; n != n_steps; ++n)
+        chain.step(dt);
+    chain.store(spheres);
+}
+
+bool stepChain(std::vector<Sphere>& spheres, glm::vec3 anchor, float length, float dt, unsigned long n_steps) {
+    switch (spheres.size()) {
+        case 2: run<2>(spheres, anchor, length, dt, n_steps); return true;
+        case 3: run<3>(spheres, anchor, length, dt, n_steps); return true;
+        case 4: run<4>(spheres, anchor, length, dt, n_steps); return true;
+        case 5: run<5>(spheres, anchor, length, dt, n_steps); return true;
+        case 6: run<6>(spheres, anchor, length, dt, n_steps); return true;
+        case 7: run<7>(spheres, anchor, length, dt, n_steps); return true;
+        case 8: run<8>(spheres, anchor, length, dt, n_steps); return true;
+        default: return false;
+    }
+}
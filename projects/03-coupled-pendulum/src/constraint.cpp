@@ -0,0 +1,165 @@
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <vector>
+
+#include "constraint.hpp"
+#include "parallel.hpp"
+
+// Constraints per parallel chunk, below that a job costs more than it saves
+static const size_t GRAIN = 4096;
+// Colors tracked per sphere, constraints past that land in one extra color solved serially
+static const unsigned int MAX_COLORS = 64;
+
+
+ConstraintSolver::ConstraintSolver(Solver_Mode mode, unsigned int iterations): mode(mode), iterations(iterations), omega(1.0f), n_spheres(0), dirty(true) {};
+
+void ConstraintSolver::add(const DistanceConstraint& c) {
+    constraints.push_back(c);
+    dirty = true;
+};
+
+void ConstraintSolver::clear() {
+    constraints.clear();
+    dirty = true;
+};
+
+void addChain(ConstraintSolver& solver, int n, glm::vec3 anchor, float length) {
+    for (int i = 0; i != n; ++i)
+        solver.add({i - 1, i, length, anchor});
+};
+
+// Position correction of both ends so that the distance is back to c.length.
+// Ends are weighted by inverse mass, the anchor does not move.
+static void project(const DistanceConstraint& c, const std::vector<Sphere>& spheres, glm::vec3& da, glm::vec3& db) {
+    const Sphere& sb = spheres[c.b];
+    glm::vec3 pa = c.a < 0 ? c.anchor : spheres[c.a].pos;
+    float wa = c.a < 0 ? 0.0f : 1.0f / spheres[c.a].m;
+    float wb = 1.0f / sb.m;
+
+    glm::vec3 diff = sb.pos - pa;
+    float d = glm::length(diff);
+    if (d == 0.0f || wa + wb == 0.0f) {
+        da = db = glm::vec3(0.0f);
+        return;
+    }
+
+    glm::vec3 n = diff / d;
+    float C = d - c.length;
+    da =  (wa / (wa + wb)) * C * n;
+    db = -(wb / (wa + wb)) * C * n;
+}
+
+void ConstraintSolver::build(size_t n) {
+    n_spheres = n;
+
+    // Greedy coloring: smallest color not yet used by either end
+    std::vector<uint64_t> used(n, 0);
+    std::vector<unsigned int> colorOf(constraints.size());
+    std::vector<unsigned int> count(MAX_COLORS + 1, 0);
+    for (size_t i = 0; i != constraints.size(); ++i) {
+        const DistanceConstraint& c = constraints[i];
+        uint64_t mask = used[c.b] | (c.a < 0 ? 0 : used[c.a]);
+        unsigned int color = 0;
+        while (color < MAX_COLORS && (mask >> color) & 1)
+            ++color;
+        if (color < MAX_COLORS) {
+            used[c.b] |= uint64_t(1) << color;
+            if (c.a >= 0)
+                used[c.a] |= uint64_t(1) << color;
+        }
+        colorOf[i] = color;
+        ++count[color];
+    }
+
+    unsigned int n_colors = MAX_COLORS + 1;
+    while (n_colors > 0 && count[n_colors - 1] == 0)
+        --n_colors;
+
+    // Sort the constraints by color (stable, so solving order stays deterministic)
+    colorStart.assign(n_colors + 1, 0);
+    for (unsigned int c = 0; c != n_colors; ++c)
+        colorStart[c + 1] = colorStart[c] + count[c];
+
+    std::vector<unsigned int> fill(colorStart.begin(), colorStart.end() - 1);
+    std::vector<DistanceConstraint> sorted(constraints.size());
+    for (size_t i = 0; i != constraints.size(); ++i)
+        sorted[fill[colorOf[i]]++] = constraints[i];
+    constraints.swap(sorted);
+
+    // Sphere -> touching constraint ends, entry is 2 * constraint + (0 for a, 1 for b)
+    adjStart.assign(n + 1, 0);
+    for (size_t i = 0; i != constraints.size(); ++i) {
+        ++adjStart[constraints[i].b + 1];
+        if (constraints[i].a >= 0)
+            ++adjStart[constraints[i].a + 1];
+    }
+    for (size_t s = 0; s != n; ++s)
+        adjStart[s + 1] += adjStart[s];
+
+    adjacency.resize(adjStart[n]);
+    fill.assign(adjStart.begin(), adjStart.end() - 1);
+    for (size_t i = 0; i != constraints.size(); ++i) {
+        adjacency[fill[constraints[i].b]++] = 2 * i + 1;
+        if (constraints[i].a >= 0)
+            adjacency[fill[constraints[i].a]++] = 2 * i;
+    }
+    corrections.resize(2 * constraints.size());
+
+    dirty = false;
+}
+
+void ConstraintSolver::solve(std::vector<Sphere>& spheres) {
+    if (dirty || n_spheres != spheres.size())
+        build(spheres.size());
+
+    for (unsigned int it = 0; it != iterations; ++it) {
+        if (mode == JACOBI)
+            solveJacobi(spheres);
+        else
+            solveColored(spheres);
+    }
+}
+
+void ConstraintSolver::solveColored(std::vector<Sphere>& spheres) {
+    for (unsigned int color = 0; color != nColors(); ++color) {
+        auto solveRange = [&](size_t begin, size_t end) {
+            for (size_t i = begin; i != end; ++i) {
+                const DistanceConstraint& c = constraints[i];
+                glm::vec3 da, db;
+                project(c, spheres, da, db);
+                if (c.a >= 0)
+                    spheres[c.a].pos += da;
+                spheres[c.b].pos += db;
+            }
+        };
+
+        // The overflow color may share spheres, it cannot be split
+        if (color == MAX_COLORS)
+            solveRange(colorStart[color], colorStart[color + 1]);
+        else
+            parallel_for(colorStart[color], colorStart[color + 1], GRAIN, solveRange);
+    }
+}
+
+void ConstraintSolver::solveJacobi(std::vector<Sphere>& spheres) {
+    // All constraints see the same positions
+    parallel_for(0, constraints.size(), GRAIN, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i != end; ++i)
+            project(constraints[i], spheres, corrections[2 * i], corrections[2 * i + 1]);
+    });
+
+    // Average what each sphere received
+    parallel_for(0, spheres.size(), GRAIN, [&](size_t begin, size_t end) {
+        for (size_t s = begin; s != end; ++s) {
+            unsigned int n = adjStart[s + 1] - adjStart[s];
+            if (n == 0)
+                continue;
+
+            glm::vec3 sum(0.0f);
+            for (unsigned int k = adjStart[s]; k != adjStart[s + 1]; ++k)
+                sum += corrections[adjacency[k]];
+            spheres[s].pos += (omega / n) * sum;
+        }
+    });
+}
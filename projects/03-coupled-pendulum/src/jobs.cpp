@@ -0,0 +1,213 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+
+#include "jobs.hpp"
+
+// The system and the deque of the current thread, when it is a worker
+static thread_local const JobSystem* current_system = nullptr;
+static thread_local unsigned int current_index = 0;
+
+// Spin, then yield, then sleep: a waiting thread gives its core back after a few microseconds
+struct Backoff {
+    unsigned int n = 0;
+
+    void idle() {
+        ++n;
+        if (n < 64)
+            return;
+        if (n < 128)
+            std::this_thread::yield();
+        else
+            std::this_thread::sleep_for(std::chrono::microseconds(50));
+    };
+    void reset() { n = 0; };
+};
+
+
+JobSystem::JobSystem(unsigned int n_workers): queues(new Queue[n_workers + 1]), queued(0), stop(false), sleeping(0) {
+    threads.reserve(n_workers);
+    for (unsigned int i = 0; i != n_workers; ++i)
+        threads.emplace_back(&JobSystem::work, this, i + 1);
+};
+
+JobSystem::~JobSystem() {
+    stop = true;
+    {
+        std::lock_guard<std::mutex> lock(sleep_mutex);
+        sleep_cv.notify_all();
+    }
+    for (std::vector<std::thread>::iterator it = threads.begin(); it != threads.end(); ++it)
+        it->join();
+};
+
+JobSystem& JobSystem::instance() {
+    static JobSystem system(hardwareThreads() - 1);
+    return system;
+};
+
+JobHandle JobSystem::create(std::function<void()> task) {
+    JobHandle job = std::make_shared<Job>();
+    job->task = std::move(task);
+    job->pending = 1;
+    job->done = false;
+    return job;
+};
+
+void JobSystem::depend(const JobHandle& job, const JobHandle& dependency) {
+    std::lock_guard<std::mutex> lock(dependency->mutex);
+    if (dependency->done)
+        return;
+    ++job->pending;
+    dependency->next.push_back(job);
+};
+
+void JobSystem::submit(const JobHandle& job) {
+    if (--job->pending == 0)
+        push(job);
+};
+
+void JobSystem::wait(const JobHandle& job) {
+    Backoff backoff;
+    while (!job->done) {
+        if (runOne())
+            backoff.reset();
+        else
+            backoff.idle();
+    }
+};
+
+void JobSystem::parallel_for(size_t begin, size_t end, size_t grain, const std::function<void(size_t, size_t)>& f) {
+    if (end <= begin)
+        return;
+    grain = std::max<size_t>(grain, 1);
+    if (end - begin <= grain || threads.empty()) {
+        f(begin, end);
+        return;
+    }
+
+    std::atomic<size_t> remaining(end - begin);
+    std::function<void(size_t, size_t)> split = [&](size_t b, size_t e) {
+        while (e - b > grain) {
+            size_t n_pieces = (e - b + grain - 1) / grain;
+            size_t mid = b + n_pieces / 2 * grain;
+            submit(create([&split, mid, e]() { split(mid, e); }));
+            e = mid;
+        }
+        f(b, e);
+        remaining -= e - b;
+    };
+    split(begin, end);
+
+    Backoff backoff;
+    while (remaining != 0) {
+        if (runOne())
+            backoff.reset();
+        else
+            backoff.idle();
+    }
+};
+
+unsigned int JobSystem::index() const {
+    return current_system == this ? current_index : 0;
+};
+
+void JobSystem::push(const JobHandle& job) {
+    Queue& queue = queues[index()];
+    {
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        queue.jobs.push_back(job);
+    }
+    ++queued;
+    if (sleeping != 0) {
+        std::lock_guard<std::mutex> lock(sleep_mutex);
+        sleep_cv.notify_one();
+    }
+};
+
+JobHandle JobSystem::pop() {
+    if (queued == 0)
+        return JobHandle();
+
+    // Own deque first, newest job
+    unsigned int self = index();
+    {
+        Queue& queue = queues[self];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (!queue.jobs.empty()) {
+            JobHandle job = std::move(queue.jobs.back());
+            queue.jobs.pop_back();
+            --queued;
+            return job;
+        }
+    }
+
+    // Then steal the oldest job of another one, starting from a random victim so thieves spread
+    static thread_local uint32_t state = 0x9e3779b9u ^ (uint32_t)std::hash<std::thread::id>()(std::this_thread::get_id());
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    unsigned int n_queues = threads.size() + 1;
+    for (unsigned int i = 0; i != n_queues; ++i) {
+        unsigned int victim = (state + i) % n_queues;
+        if (victim == self)
+            continue;
+        Queue& queue = queues[victim];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (!queue.jobs.empty()) {
+            JobHandle job = std::move(queue.jobs.front());
+            queue.jobs.pop_front();
+            --queued;
+            return job;
+        }
+    }
+    return JobHandle();
+};
+
+bool JobSystem::runOne() {
+    JobHandle job = pop();
+    if (!job)
+        return false;
+    execute(job);
+    return true;
+};
+
+void JobSystem::execute(const JobHandle& job) {
+    job->task();
+    // Drop the captures now, a job may hold handles on others
+    job->task = nullptr;
+
+    std::vector<JobHandle> next;
+    {
+        std::lock_guard<std::mutex> lock(job->mutex);
+        job->done = true;
+        next.swap(job->next);
+    }
+    for (std::vector<JobHandle>::iterator it = next.begin(); it != next.end(); ++it)
+        submit(*it);
+};
+
+void JobSystem::work(unsigned int index) {
+    current_system = this;
+    current_index = index;
+
+    Backoff backoff;
+    while (!stop) {
+        if (runOne()) {
+            backoff.reset();
+            continue;
+        }
+        if (backoff.n < 128) {
+            backoff.idle();
+            continue;
+        }
+
+        // Nothing for a while: sleep until a push, the timeout only guards against a missed one
+        std::unique_lock<std::mutex> lock(sleep_mutex);
+        ++sleeping;
+        if (queued == 0 && !stop)
+            sleep_cv.wait_for(lock, std::chrono::milliseconds(100));
+        --sleeping;
+        backoff.reset();
+    }
+};
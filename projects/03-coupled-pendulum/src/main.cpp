@@ -5,6 +5,7 @@
 #include <glm/gtc/type_ptr.hpp>
 #include <glm/gtc/random.hpp>
 
+#include <cstdlib>
 #include <filesystem>
 #include <iostream>
 #include <string.h>
@@ -17,6 +18,9 @@
 #include "object.hpp"
 #include "setupGL.hpp"
 #include "physics.hpp"
+#include "constraint.hpp"
+#include "lyapunov.hpp"
+#include "chain.hpp"
 
 
 const unsigned int SCR_WIDTH = 1920;
@@ -42,8 +46,49 @@ void print(glm::vec3 v){
     std::cout << v.x << ", " << v.y << ", " << v.z << std::endl;
 };
 
+// Random chain hanging from center
+void initChain(std::vector<Sphere>& spheres, glm::vec3 center, float rod_length){
+    glm::vec3 start(center);
+
+    for (std::vector<Sphere>::iterator it=spheres.begin(); it!=spheres.end(); ++it ) {
+        // Set starting position satisfying distance from previous ball
+        it->pos = start + glm::ballRand(rod_length);
+        it->prev_pos = it->pos;
+        start = it->pos;
+
+        // Set other spheres properties
+        it->vel = glm::ballRand(0.5f);
+        it->color = glm::linearRand(glm::vec3(0.0f), glm::vec3(1.0f));
+        it->radius = glm::linearRand(0.1f, 0.2f);
+        it->m = (4/3) * M_PI * it->radius * it->radius * it->radius;
+    }
+}
+
+// Headless: largest Lyapunov exponent of n random initial conditions
+// usage: --lyapunov <n_conditions> <output.csv> [n_pendulum]
+int runLyapunov(int argc, char** argv){
+    int n_conditions = argc > 2 ? std::atoi(argv[2]) : 0;
+    int n_pendulum = argc > 4 ? std::atoi(argv[4]) : 2;
+    // atoi gives 0 for garbage, a negative count would become a huge vector size
+    if (argc < 4 || n_conditions <= 0 || n_pendulum <= 0) {
+        std::cout << "usage: " << argv[0] << " --lyapunov <n_conditions> <output.csv> [n_pendulum]" << std::endl;
+        return 1;
+    }
+
+    LyapunovSettings settings;
+    std::vector<std::vector<Sphere>> initials(n_conditions, std::vector<Sphere>(n_pendulum));
+    for (std::vector<std::vector<Sphere>>::iterator it=initials.begin(); it!=initials.end(); ++it)
+        initChain(*it, settings.center, settings.rod_length);
+
+    std::vector<LyapunovResult> results = lyapunov(initials, settings);
+    return writeLyapunov(argv[3], results, settings) ? 0 : 1;
+}
+
 int main(int argc, char** argv)
 {
+    if (argc > 1 && std::string(argv[1]) == "--lyapunov")
+        return runLyapunov(argc, argv);
+
     std::string title = "PhysicsSim";
     unsigned int width = 1920;
     unsigned int height = 1080;
@@ -72,21 +117,12 @@ int main(int argc, char** argv)
     int n_pendulum = 2;
     std::vector<Sphere> spheres(n_pendulum);
     glm::vec3 center(0.0f, 0.0f, 0.0f);
-    glm::vec3 start(center);
+    float rod_length = 1.0f;
+    initChain(spheres, center, rod_length);
 
-    for (std::vector<Sphere>::iterator it=spheres.begin(); it!=spheres.end(); ++it ) {
-        float rod_length = 1.0f;
-        // Set starting position satisfying distance from previous ball
-        it->pos = start + glm::ballRand(rod_length);
-        it->prev_pos = it->pos;
-        start = it->pos;
-
-        // Set other spheres properties
-        it->vel = glm::ballRand(0.5f);
-        it->color = glm::linearRand(glm::vec3(0.0f), glm::vec3(1.0f));
-        it->radius = glm::linearRand(0.1f, 0.2f);
-        it->m = (4/3) * M_PI * it->radius * it->radius * it->radius;
-    }
+    // Rods: first sphere hangs from the center, each next one from the previous
+    ConstraintSolver solver(GAUSS_SEIDEL);
+    addChain(solver, n_pendulum, center, rod_length);
 
     // Transforms
     glm::mat4 proj;
@@ -133,36 +169,20 @@ int main(int argc, char** argv)
         blockShader.setMat4f("view", view);
 
         float dt = deltaTime / n_substeps;
-        for (unsigned int step=0; step!=n_substeps; ++step){
-            // Move the particles
+        for (unsigned int substep=0; substep!=n_substeps; ++substep){
+            // Plot the spheres
             for (std::vector<Sphere>::iterator it=spheres.begin(); it!=spheres.end(); ++it) {
-                // Plot the spheres
                 model = glm::mat4(1.0f);
                 model = glm::translate(model, it->pos);
                 model = glm::scale(model, glm::vec3(1.0f, 1.0f, 1.0f) * it->radius);
                 blockShader.setMat4f("model", model);
                 blockShader.set3f("objectColor", it->color);
                 mesh_sphere.Draw();
-
-                // move the spheres
-                it->prev_pos = it->pos;
-                move(*it, dt);
-            }
-
-            // Solve constraints
-            start = center;
-            for (std::vector<Sphere>::iterator it=spheres.begin(); it!=spheres.end(); ++it) {
-                glm::vec3 dir = glm::normalize(it->pos - start);
-                // TODO: change 1.0f to rod length
-                it->pos = start + 1.0f * dir;
-                start = it->pos;
-            }
-
-            // Update velocities
-            for (std::vector<Sphere>::iterator it=spheres.begin(); it!=spheres.end(); ++it) {
-                it->vel = (it->pos - it->prev_pos) / dt;
             }
 
+            // Move the spheres, solve constraints and update velocities
+            if (!stepChain(spheres, center, rod_length, dt))
+                step(spheres, solver, dt);
         }
 
         // Draw the light!
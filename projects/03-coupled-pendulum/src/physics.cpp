@@ -1,12 +1,13 @@
 #include <glm/glm.hpp>
 
 #include "object.hpp"
+#include "physics.hpp"
 #include <iostream>
 
 
-float energy(glm::vec3 pos, glm::vec3 v){
+float energy(const Sphere& s){
     glm::vec3 g(0.0f, -10.f, 0.0f);
-    return -g.y*pos.y + 0.5 * dot(v, v);
+    return s.m * (-g.y*s.pos.y + 0.5f * glm::dot(s.vel, s.vel));
 };
 
 
@@ -72,3 +73,19 @@ void move(Sphere& s, float dt){
 
     // s.vel = (s.pos - p) / dt;
 }
+
+void step(std::vector<Sphere>& spheres, ConstraintSolver& solver, float dt){
+    // Move the particles
+    for (std::vector<Sphere>::iterator it=spheres.begin(); it!=spheres.end(); ++it) {
+        it->prev_pos = it->pos;
+        move(*it, dt);
+    }
+
+    // Solve constraints
+    solver.solve(spheres);
+
+    // Update velocities
+    for (std::vector<Sphere>::iterator it=spheres.begin(); it!=spheres.end(); ++it) {
+        it->vel = (it->pos - it->prev_pos) / dt;
+    }
+}
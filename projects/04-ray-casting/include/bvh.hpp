@@ -0,0 +1,37 @@
+#pragma once
+
+#include <vector>
+#include <glm/glm.hpp>
+
+#include "object.hpp"
+#include "ray.hpp"
+
+// Bounding volume hierarchy over a set of spheres.
+// Built top-down with binned SAH, then only refitted while the spheres move
+// (the tree stays valid, it just gets looser: rebuild when the scene changes a lot).
+class BVH {
+    public:
+        void build(const std::vector<Sphere>& spheres);
+        void refit(const std::vector<Sphere>& spheres);
+
+        // Closest sphere along the ray (t >= 0)
+        RayHit intersect(const Ray& ray, const std::vector<Sphere>& spheres) const;
+
+        bool empty() const { return nodes.empty(); };
+        size_t size() const { return indices.size(); };
+
+    private:
+        // 32 bytes: two per cache line
+        struct Node {
+            glm::vec3 lo;
+            unsigned int first;     // leaf: first entry in indices, inner: index of the left child (right is first + 1)
+            glm::vec3 hi;
+            unsigned int count;     // number of spheres for a leaf, 0 for an inner node
+        };
+
+        std::vector<Node> nodes;
+        std::vector<unsigned int> indices;
+
+        void subdivide(unsigned int node, unsigned int depth, const std::vector<Sphere>& spheres, std::vector<glm::vec3>& centroids);
+        void bound(Node& node, const std::vector<Sphere>& spheres) const;
+};
@@ -4,6 +4,7 @@
 #include <vector>
 #include <glm/glm.hpp>
 #include <glm/gtx/norm.hpp>
+#include <glm/gtc/quaternion.hpp>
 
 #include "ray.hpp"
 
@@ -17,32 +18,43 @@ class Sphere {
         float radius;
         float m;
 
-        bool intersects(const Ray& ray, float& t){
+        bool intersects(const Ray& ray, float& t) const {
             // I just solve that the length of the vector which direction is from center of sphere to the ray is exactly the radius of the sphere.
+            // |OS + t dir|^2 = r^2 with |dir| = 1  =>  t^2 + 2 b t + c = 0
             glm::vec3 OS = ray.O - this->pos;
+            float b = glm::dot(ray.dir, OS);
+            float c = glm::length2(OS) - radius*radius;
 
-            float delta = glm::pow(2 * glm::dot(ray.dir, OS), 2) - 4 * (glm::length2(OS) - radius*radius);
-
+            float delta = b*b - c;
             if (delta < 0)
                 return false;
 
             delta = glm::sqrt(delta);
 
-            // TODO: Understand why t is negative here...
-            t = glm::min(-glm::dot(ray.O, OS) + delta/2, -glm::dot(ray.O, OS) - delta/2);
-            return true;
+            // Closest hit in front of the origin, the far one if the origin is inside the sphere
+            t = -b - delta;
+            if (t < 0)
+                t = -b + delta;
+            return t >= 0;
         };
 };
 class Cube {
     public:
-        Cube(glm::vec3 size = glm::vec3(1.0f)): size(size){};
+        Cube(glm::vec3 size = glm::vec3(1.0f)): size(size), orient(1.0f, 0.0f, 0.0f, 0.0f), vel(0.0f), angVel(0.0f), m(0.0f) {};
         glm::vec3 pos;
         glm::vec3 size;
         glm::vec3 color;
+
+        // Rigid body state, a mass of 0 makes the box static
+        glm::quat orient;
+        glm::vec3 vel;
+        glm::vec3 angVel;
         float m;
 
-        // TODO: Implement
-        bool intersects(const Ray& r, float& t);
+        // Slab test in box space, takes the orientation into account
+        bool intersects(const Ray& r, float& t) const;
+        // Same ignoring the orientation, for boxes known to be axis aligned
+        bool intersectsAABB(const Ray& r, float& t) const;
 };
 
 
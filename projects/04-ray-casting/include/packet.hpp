@@ -0,0 +1,60 @@
+#pragma once
+
+#include <vector>
+#include <glm/glm.hpp>
+
+#include "object.hpp"
+#include "ray.hpp"
+
+// Spheres in structure of arrays layout, for batched ray queries
+struct SphereSoA {
+    std::vector<float> x, y, z;
+    std::vector<float> r2;      // squared radius
+
+    void assign(const std::vector<Sphere>& spheres);
+    size_t size() const { return x.size(); };
+};
+
+// Boxes in structure of arrays layout: center, half size and the box axes in world space
+struct BoxSoA {
+    std::vector<float> x, y, z;
+    std::vector<float> hx, hy, hz;
+    std::vector<float> ux, uy, uz, vx, vy, vz, wx, wy, wz;
+
+    void assign(const std::vector<Cube>& boxes);
+    size_t size() const { return x.size(); };
+};
+
+// Closest box for one ray, same t as Cube::intersectsAABB / Cube::intersects.
+// The box loop is branch free so many boxes are tested per instruction.
+RayHit intersectAABB(const Ray& ray, const BoxSoA& boxes);
+RayHit intersectOBB(const Ray& ray, const BoxSoA& boxes);
+
+// W coherent rays (e.g. a tile of pixels or a sensor sweep) in SoA layout.
+// The lanes are processed together so the compiler can map them to SIMD registers.
+template<int W>
+struct RayPacket {
+    alignas(64) float ox[W];
+    alignas(64) float oy[W];
+    alignas(64) float oz[W];
+    alignas(64) float dx[W];
+    alignas(64) float dy[W];
+    alignas(64) float dz[W];
+
+    // results of intersect(): nearest t >= 0 and sphere index, -1 on a miss
+    alignas(64) float t[W];
+    alignas(64) int index[W];
+
+    // dir must be normalized, like for Sphere::intersects
+    void set(int lane, const Ray& ray) {
+        ox[lane] = ray.O.x; oy[lane] = ray.O.y; oz[lane] = ray.O.z;
+        dx[lane] = ray.dir.x; dy[lane] = ray.dir.y; dz[lane] = ray.dir.z;
+    };
+};
+
+// Closest sphere of the set for every ray of the packet, same t as Sphere::intersects
+template<int W>
+void intersect(RayPacket<W>& packet, const SphereSoA& spheres);
+
+extern template void intersect<8>(RayPacket<8>&, const SphereSoA&);
+extern template void intersect<16>(RayPacket<16>&, const SphereSoA&);
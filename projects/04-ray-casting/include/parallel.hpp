@@ -0,0 +1,43 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <thread>
+#include <vector>
+
+inline unsigned int hardwareThreads() {
+    unsigned int n = std::thread::hardware_concurrency();
+    return n == 0 ? 1 : n;
+}
+
+// Calls f(begin, end) on chunks of at most `grain` elements spread over all the cores.
+// Chunks are handed out dynamically so uneven work still balances.
+// Runs inline when the range fits in a single chunk.
+template<typename F>
+void parallel_for(size_t begin, size_t end, size_t grain, F&& f) {
+    if (end <= begin)
+        return;
+    grain = std::max<size_t>(grain, 1);
+
+    size_t n_chunks = (end - begin + grain - 1) / grain;
+    unsigned int n_threads = n_chunks <= 1 ? 1 : (unsigned int)std::min<size_t>(hardwareThreads(), n_chunks);
+    if (n_threads <= 1) {
+        f(begin, end);
+        return;
+    }
+
+    std::atomic<size_t> next(begin);
+    auto worker = [&]() {
+        for (size_t b = next.fetch_add(grain); b < end; b = next.fetch_add(grain))
+            f(b, std::min(b + grain, end));
+    };
+
+    std::vector<std::thread> threads;
+    threads.reserve(n_threads - 1);
+    for (unsigned int i = 1; i < n_threads; ++i)
+        threads.emplace_back(worker);
+    worker();
+    for (std::vector<std::thread>::iterator it = threads.begin(); it != threads.end(); ++it)
+        it->join();
+}
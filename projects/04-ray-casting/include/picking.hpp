@@ -0,0 +1,41 @@
+#pragma once
+
+#include <glad/glad.h>
+
+// Picking on the GPU: the normal pass is drawn into a framebuffer with a second, integer,
+// color attachment where every object writes its id (fragment.fs, objectId uniform, 0 = nothing).
+// The pixel is copied to a pixel buffer object and only read back the next frame once its fence
+// has signaled, so the CPU never waits for the GPU. Cost does not depend on the scene size.
+class GpuPicker {
+    public:
+        GpuPicker(unsigned int width, unsigned int height);
+        ~GpuPicker();
+
+        // Reallocate the attachments when the window framebuffer changes size
+        void resize(unsigned int width, unsigned int height);
+
+        // Render target of the normal pass: clears color, depth and ids
+        void bind(float r, float g, float b, float a);
+        // Copy the color to the window and bind the default framebuffer again
+        void present();
+
+        // Queue the readback of the id under pixel (x, y), origin at the top left like the cursor
+        void request(unsigned int x, unsigned int y);
+        // Id of an older request if the GPU is done with it. Returns false while nothing is ready.
+        bool poll(unsigned int& id);
+        // Forget the requests still in flight
+        void cancel();
+
+    private:
+        unsigned int width, height;
+        unsigned int FBO, colorTex, idTex, depthRBO;
+
+        // Two pixel buffers: one being filled by the GPU, one being read
+        static const int N_PBO = 2;
+        unsigned int PBO[N_PBO];
+        GLsync fence[N_PBO];
+        int next;
+
+        void create();
+        void destroy();
+};
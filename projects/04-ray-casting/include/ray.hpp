@@ -7,12 +7,14 @@ class Ray {
     public:
         glm::vec3 O;
         glm::vec3 dir;
+        glm::vec3 invDir;       // 1 / dir, for the slab tests (inf on axis aligned directions)
 
-        Ray(glm::vec3 O, glm::vec3 dir): O(O), dir(dir){};
+        Ray(glm::vec3 O, glm::vec3 dir): O(O), dir(dir), invDir(1.0f / dir){};
 
         void operator() (glm::vec3 O, glm::vec3 dir) {
             this->O = O;
             this->dir = dir;
+            this->invDir = 1.0f / dir;
         };
 
         void print() const {print(0);};
@@ -25,3 +27,11 @@ class Ray {
     private:
 
 };
+
+// Result of a ray query, index is -1 when nothing is hit
+struct RayHit {
+    int index;
+    float t;
+
+    bool hit() const { return index >= 0; };
+};
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <glm/glm.hpp>
+
+#include "object.hpp"
+#include "bvh.hpp"
+
+// Many rays against the spheres at once, e.g. lidar like sensors.
+// Rays are sorted along a Morton curve of (origin, direction) so neighbours walk the same
+// BVH nodes, then traced in chunks over all the cores. Results come back in input order.
+// Keep the object around between frames: its buffers are reused.
+class RayBatch {
+    public:
+        bool sort = true;           // skip it when the rays are already coherent (e.g. a scan pattern)
+        size_t grain = 4096;        // rays per chunk handed to a thread
+
+        // dirs must be normalized. t[i] and index[i] get the closest hit of ray i,
+        // index -1 and t = max float on a miss.
+        void cast(const glm::vec3* origins, const glm::vec3* dirs, size_t n,
+                  const std::vector<Sphere>& spheres, const BVH& bvh, float* t, int* index);
+
+    private:
+        std::vector<uint32_t> keys, order;
+        std::vector<uint32_t> tmp_keys, tmp_order;
+
+        void sortRays(const glm::vec3* origins, const glm::vec3* dirs, size_t n);
+};
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <glm/glm.hpp>
+
+#include "object.hpp"
+#include "bvh.hpp"
+
+class Camera;
+
+// 8 bits RGB, rows top to bottom
+struct Image {
+    unsigned int width = 0;
+    unsigned int height = 0;
+    std::vector<unsigned char> rgb;
+
+    void resize(unsigned int width, unsigned int height);
+    // Binary PPM (P6), readable by about every image tool
+    bool writePPM(const std::string& filename) const;
+};
+
+struct RenderSettings {
+    unsigned int width = 1920;
+    unsigned int height = 1080;
+    unsigned int tile = 32;             // tiles of tile x tile pixels are handed to the workers
+    glm::vec3 lightPos = glm::vec3(0.0f, 0.6f, 1.5f);
+    glm::vec3 lightColor = glm::vec3(1.0f);
+    glm::vec3 background = glm::vec3(0.2f, 0.3f, 0.3f);   // glClearColor of the viewer
+};
+
+// CPU version of what the viewer draws: one primary ray per pixel through the BVH,
+// shaded with the Phong model of fragment.fs. Tiles are spread over all the cores.
+void render(const Camera& camera, const std::vector<Sphere>& spheres, const BVH& bvh,
+            const RenderSettings& settings, Image& image);
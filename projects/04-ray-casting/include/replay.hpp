@@ -0,0 +1,56 @@
+#pragma once
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "object.hpp"
+
+// Everything that can change the run from outside, in the order it happened
+enum Replay_Event {
+    REPLAY_KEY,         // i = Camera_Movement, a = deltaTime used for the move
+    REPLAY_MOUSE,       // a, b = offsets given to ProcessMouseMovement
+    REPLAY_SCROLL,      // a = offset
+    REPLAY_CLICK,       // i = pressed
+    REPLAY_PICK,        // i = index of the picked sphere, -1 for none (GPU picks are a frame late)
+    REPLAY_FRAME,       // end of the inputs of the frame: a = time, b = deltaTime
+    REPLAY_END
+};
+
+struct ReplayEvent {
+    uint32_t type;
+    int32_t i;
+    float a;
+    float b;
+};
+
+// Session log: the seed of std::rand (used by glm::linearRand / ballRand), then the events.
+// Feeding the events back in the same order through the same code gives the same run,
+// without a window.
+class ReplayLog {
+    public:
+        ReplayLog();
+
+        unsigned int seed;
+        unsigned int n_spheres;
+
+        bool record(const std::string& filename, unsigned int seed, unsigned int n_spheres);
+        // Appended right away when recording, nothing happens otherwise
+        void add(Replay_Event type, int i = 0, float a = 0.0f, float b = 0.0f);
+        // Ends the log with the checksum of the final state
+        void close(uint64_t checksum);
+        bool recording() const { return file.is_open(); };
+
+        bool load(const std::string& filename);
+        const std::vector<ReplayEvent>& getEvents() const { return events; };
+        uint64_t getChecksum() const { return checksum; };
+
+    private:
+        std::ofstream file;
+        std::vector<ReplayEvent> events;
+        uint64_t checksum;
+};
+
+// FNV-1a of the sphere positions, bit exact
+uint64_t stateChecksum(const std::vector<Sphere>& spheres);
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include "object.hpp"
+
+// Inverse inertia tensor of a solid box, in world frame
+glm::mat3 invInertiaWorld(const Cube& box);
+
+struct Contact {
+    glm::vec3 point;            // world position, halfway between the two surfaces
+    glm::vec3 normal;           // from body a to body b
+    float depth;                // negative while the bodies are still apart, by less than the margin
+    uint32_t feature;           // which faces/edges/vertices produced it, to find it again next frame
+
+    // accumulated impulses, kept from frame to frame for warm starting
+    float Pn = 0.0f;
+    float Pt1 = 0.0f;
+    float Pt2 = 0.0f;
+
+    // solver data, recomputed every step
+    glm::vec3 rA, rB, t1, t2;
+    float massN, massT1, massT2, bias;
+};
+
+// Up to 4 contacts between two bodies
+struct Manifold {
+    unsigned int a, b;
+    std::vector<Contact> contacts;
+};
+
+// Boxes and spheres solved with sequential impulses.
+// Boxes are bodies [0, boxes.size()), spheres come after and do not rotate.
+// Contacts are persistent: a new contact with the same feature as last frame starts from the
+// impulses found last frame, so stacks only need a few iterations to settle.
+class RigidWorld {
+    public:
+        RigidWorld();
+
+        glm::vec3 gravity;
+        unsigned int iterations;
+        float friction;
+        float baumgarte;        // fraction of the penetration removed per step
+        float slop;             // penetration allowed without correction, avoids jitter
+        float margin;           // contacts are kept up to this gap, resting contacts do not flicker
+        bool warmStart;
+
+        void step(std::vector<Cube>& boxes, std::vector<Sphere>& spheres, float dt);
+
+        size_t nContacts() const;
+        const std::unordered_map<uint64_t, Manifold>& getManifolds() const { return manifolds; };
+
+    private:
+        struct Body {
+            glm::vec3 pos;
+            glm::quat orient;
+            glm::vec3 vel;
+            glm::vec3 angVel;
+            glm::vec3 half;     // half extents for boxes
+            float radius;       // spheres only
+            float invM;
+            glm::mat3 invI;
+            bool box;
+        };
+
+        std::vector<Body> bodies;
+        std::unordered_map<uint64_t, Manifold> manifolds;
+
+        void gather(const std::vector<Cube>& boxes, const std::vector<Sphere>& spheres);
+        void scatter(std::vector<Cube>& boxes, std::vector<Sphere>& spheres) const;
+        void collide();
+        void preStep(float dt);
+        void applyImpulse(Contact& c, Body& a, Body& b, glm::vec3 P);
+        void solve();
+        void integrate(float dt);
+};
+
+// Contact generation, normal points from a to b. Surfaces less than margin apart are in contact
+// already, with a negative depth. Return the number of contacts written (max 4).
+int collideBoxBox(glm::vec3 posA, glm::quat qA, glm::vec3 halfA, glm::vec3 posB, glm::quat qB, glm::vec3 halfB, float margin, Contact* out);
+int collideBoxSphere(glm::vec3 posA, glm::quat qA, glm::vec3 halfA, glm::vec3 center, float radius, float margin, Contact* out);
@@ -19,6 +19,7 @@ class Shader
     // set uniform values
     void setBool(const std::string &name, bool value) const;
     void setInt(const std::string &name, int value) const;
+    void setUInt(const std::string &name, unsigned int value) const;
     void setFloat(const std::string &name, float value) const;
     void set2f(const std::string &name, const glm::vec2& vec) const;
     void set3f(const std::string &name, const glm::vec3& vec) const;
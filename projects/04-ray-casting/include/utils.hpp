@@ -5,6 +5,8 @@
 #include "camera.hpp"
 #include "ray.hpp"
 #include "object.hpp"
+#include "bvh.hpp"
+#include "replay.hpp"
 
 extern Camera camera;
 extern float lastX, lastY;
@@ -13,6 +15,9 @@ extern bool firstMouse;
 extern float deltaTime;
 extern float lastFrame;
 
+// Inputs are logged here when a session is being recorded
+extern ReplayLog session;
+
 // Callback to resize Viewport
 void framebuffer_size_callback(GLFWwindow* window, int width, int height);
 
@@ -28,5 +33,8 @@ int logShaderCompile(const unsigned int shaderId, const char* shaderType);
 
 int logProgramLink(const unsigned int shaderProgram);
 
-// Get object from casted ray
+// Get object from casted ray, nullptr when nothing is hit
 Sphere* ObjectRayCast(Ray&, std::vector<Sphere>&);
+Cube* ObjectRayCast(Ray&, std::vector<Cube>&);
+// Same through the BVH of the spheres, also gives the hit distance
+RayHit ObjectRayCast(const Ray&, const std::vector<Sphere>&, const BVH&);
@@ -10,7 +10,11 @@ uniform vec3 lightPos;
 // We can actually compute in view space and not need viewPos here because viewPos is always (0,0,0) in that case.
 uniform vec3 viewPos;
 
-out vec4 FragColor;
+// Written to the integer attachment of the picking framebuffer, 0 means nothing
+uniform uint objectId;
+
+layout (location = 0) out vec4 FragColor;
+layout (location = 1) out uint ObjectId;
 
 void main()
 {
@@ -35,4 +39,5 @@ void main()
    vec3 result = (ambient + diffuse + specular) * objectColor;
 
    FragColor = vec4(result, 1.0);
+   ObjectId = objectId;
 }
@@ -1,10 +1,13 @@
 #version 330 core
 
-out vec4 FragColor;
+layout (location = 0) out vec4 FragColor;
+layout (location = 1) out uint ObjectId;
 
 uniform vec3 lightColor;
 
 void main()
 {
    FragColor = vec4(lightColor, 1.0);
+   // The light cannot be picked
+   ObjectId = 0u;
 }
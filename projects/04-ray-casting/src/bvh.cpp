@@ -0,0 +1,206 @@
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <limits>
+#include <vector>
+
+#include "bvh.hpp"
+
+static const int N_BINS = 12;
+static const unsigned int MAX_LEAF = 4;
+// Deeper nodes stay leaves, whatever their count: the traversal stack holds MAX_DEPTH + 1 entries
+static const unsigned int MAX_DEPTH = 64;
+static const float INF = std::numeric_limits<float>::max();
+
+static float area(glm::vec3 lo, glm::vec3 hi) {
+    glm::vec3 e = hi - lo;
+    return e.x * e.y + e.y * e.z + e.z * e.x;
+}
+
+// Entry distance of the ray in the box, INF when it misses or enters further than tmax
+static float slab(glm::vec3 lo, glm::vec3 hi, glm::vec3 O, glm::vec3 invDir, float tmax) {
+    glm::vec3 t0 = (lo - O) * invDir;
+    glm::vec3 t1 = (hi - O) * invDir;
+    glm::vec3 tnear = glm::min(t0, t1);
+    glm::vec3 tfar = glm::max(t0, t1);
+    float enter = glm::max(glm::max(tnear.x, tnear.y), glm::max(tnear.z, 0.0f));
+    float exit = glm::min(glm::min(tfar.x, tfar.y), glm::min(tfar.z, tmax));
+    return enter <= exit ? enter : INF;
+}
+
+
+void BVH::bound(Node& node, const std::vector<Sphere>& spheres) const {
+    node.lo = glm::vec3(INF);
+    node.hi = glm::vec3(-INF);
+    for (unsigned int i = node.first; i != node.first + node.count; ++i) {
+        const Sphere& s = spheres[indices[i]];
+        node.lo = glm::min(node.lo, s.pos - glm::vec3(s.radius));
+        node.hi = glm::max(node.hi, s.pos + glm::vec3(s.radius));
+    }
+}
+
+void BVH::build(const std::vector<Sphere>& spheres) {
+    nodes.clear();
+    indices.resize(spheres.size());
+    if (spheres.empty())
+        return;
+
+    std::vector<glm::vec3> centroids(spheres.size());
+    for (unsigned int i = 0; i != spheres.size(); ++i) {
+        indices[i] = i;
+        centroids[i] = spheres[i].pos;
+    }
+
+    nodes.reserve(2 * spheres.size());
+    nodes.push_back({glm::vec3(0.0f), 0, glm::vec3(0.0f), (unsigned int)spheres.size()});
+    bound(nodes[0], spheres);
+    subdivide(0, 0, spheres, centroids);
+}
+
+void BVH::subdivide(unsigned int n, unsigned int depth, const std::vector<Sphere>& spheres, std::vector<glm::vec3>& centroids) {
+    Node node = nodes[n];
+    if (node.count <= MAX_LEAF || depth == MAX_DEPTH)
+        return;
+
+    // Split along the longest axis of the centroids
+    glm::vec3 clo(INF), chi(-INF);
+    for (unsigned int i = node.first; i != node.first + node.count; ++i) {
+        clo = glm::min(clo, centroids[indices[i]]);
+        chi = glm::max(chi, centroids[indices[i]]);
+    }
+    glm::vec3 extent = chi - clo;
+    int axis = extent.x > extent.y ? (extent.x > extent.z ? 0 : 2) : (extent.y > extent.z ? 1 : 2);
+    if (extent[axis] <= 0.0f)
+        return;
+
+    // Bin the spheres and evaluate the surface area heuristic at every bin boundary
+    struct Bin {
+        glm::vec3 lo = glm::vec3(INF);
+        glm::vec3 hi = glm::vec3(-INF);
+        unsigned int count = 0;
+    } bins[N_BINS];
+    float scale = N_BINS / extent[axis];
+    auto binOf = [&](unsigned int i) {
+        return std::min(N_BINS - 1, (int)((centroids[i][axis] - clo[axis]) * scale));
+    };
+    for (unsigned int i = node.first; i != node.first + node.count; ++i) {
+        const Sphere& s = spheres[indices[i]];
+        Bin& b = bins[binOf(indices[i])];
+        b.lo = glm::min(b.lo, s.pos - glm::vec3(s.radius));
+        b.hi = glm::max(b.hi, s.pos + glm::vec3(s.radius));
+        ++b.count;
+    }
+
+    float leftArea[N_BINS - 1];
+    unsigned int leftCount[N_BINS - 1];
+    glm::vec3 lo(INF), hi(-INF);
+    unsigned int count = 0;
+    for (int i = 0; i != N_BINS - 1; ++i) {
+        lo = glm::min(lo, bins[i].lo);
+        hi = glm::max(hi, bins[i].hi);
+        count += bins[i].count;
+        leftCount[i] = count;
+        leftArea[i] = count ? area(lo, hi) : 0.0f;
+    }
+
+    float bestCost = INF;
+    int bestSplit = -1;
+    lo = glm::vec3(INF);
+    hi = glm::vec3(-INF);
+    count = 0;
+    for (int i = N_BINS - 1; i != 0; --i) {
+        lo = glm::min(lo, bins[i].lo);
+        hi = glm::max(hi, bins[i].hi);
+        count += bins[i].count;
+        if (count == 0 || leftCount[i - 1] == 0)
+            continue;
+        float cost = leftCount[i - 1] * leftArea[i - 1] + count * area(lo, hi);
+        if (cost < bestCost) {
+            bestCost = cost;
+            bestSplit = i;
+        }
+    }
+
+    // Splitting must beat intersecting every sphere of the node
+    if (bestSplit < 0 || bestCost >= node.count * area(node.lo, node.hi))
+        return;
+
+    unsigned int* mid = std::partition(&indices[node.first], &indices[node.first] + node.count,
+                                       [&](unsigned int i) { return binOf(i) < bestSplit; });
+    unsigned int n_left = mid - &indices[node.first];
+
+    unsigned int left = nodes.size();
+    nodes.push_back({glm::vec3(0.0f), node.first, glm::vec3(0.0f), n_left});
+    nodes.push_back({glm::vec3(0.0f), node.first + n_left, glm::vec3(0.0f), node.count - n_left});
+    bound(nodes[left], spheres);
+    bound(nodes[left + 1], spheres);
+
+    nodes[n].first = left;
+    nodes[n].count = 0;
+
+    subdivide(left, depth + 1, spheres, centroids);
+    subdivide(left + 1, depth + 1, spheres, centroids);
+}
+
+void BVH::refit(const std::vector<Sphere>& spheres) {
+    if (spheres.size() != indices.size()) {
+        build(spheres);
+        return;
+    }
+
+    // Children are always stored after their parent: walk backward
+    for (size_t n = nodes.size(); n-- != 0;) {
+        Node& node = nodes[n];
+        if (node.count != 0) {
+            bound(node, spheres);
+        } else {
+            const Node& l = nodes[node.first];
+            const Node& r = nodes[node.first + 1];
+            node.lo = glm::min(l.lo, r.lo);
+            node.hi = glm::max(l.hi, r.hi);
+        }
+    }
+}
+
+RayHit BVH::intersect(const Ray& ray, const std::vector<Sphere>& spheres) const {
+    RayHit hit = {-1, INF};
+    if (nodes.empty())
+        return hit;
+
+    if (slab(nodes[0].lo, nodes[0].hi, ray.O, ray.invDir, INF) == INF)
+        return hit;
+
+    // Each level leaves at most one node behind: MAX_DEPTH + 1 entries are enough
+    unsigned int stack[MAX_DEPTH + 1];
+    int top = 0;
+    stack[top++] = 0;
+
+    while (top != 0) {
+        const Node& node = nodes[stack[--top]];
+
+        if (node.count != 0) {
+            for (unsigned int i = node.first; i != node.first + node.count; ++i) {
+                float t;
+                if (spheres[indices[i]].intersects(ray, t) && t < hit.t) {
+                    hit.t = t;
+                    hit.index = indices[i];
+                }
+            }
+            continue;
+        }
+
+        // Visit the closest child first, skip anything beyond the current hit
+        unsigned int near = node.first, far = node.first + 1;
+        float tnear = slab(nodes[near].lo, nodes[near].hi, ray.O, ray.invDir, hit.t);
+        float tfar = slab(nodes[far].lo, nodes[far].hi, ray.O, ray.invDir, hit.t);
+        if (tfar < tnear) {
+            std::swap(near, far);
+            std::swap(tnear, tfar);
+        }
+        if (tfar != INF)
+            stack[top++] = far;
+        if (tnear != INF)
+            stack[top++] = near;
+    }
+    return hit;
+}
@@ -6,6 +6,9 @@
 #include <glm/gtc/random.hpp>
 #include <glm/gtx/norm.hpp>
 
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
 #include <filesystem>
 #include <iostream>
 #include <string.h>
@@ -19,6 +22,12 @@
 #include "setupGL.hpp"
 #include "physics.hpp"
 #include "ray.hpp"
+#include "bvh.hpp"
+#include "raytracer.hpp"
+#include "parallel.hpp"
+#include "picking.hpp"
+#include "replay.hpp"
+#include "rigidbody.hpp"
 
 
 const unsigned int SCR_WIDTH = 1920;
@@ -34,15 +43,255 @@ bool firstMouse = true;
 float deltaTime = 0.0f;
 float lastFrame = 0.0f;
 
+ReplayLog session;
 
-const std::string block_v_shader("../projects/01-bouncing_ball/resources/shaders/vertex.vs");
-const std::string block_f_shader("../projects/01-bouncing_ball/resources/shaders/fragment.fs");
-const std::string light_v_shader("../projects/01-bouncing_ball/resources/shaders/light_cube.vs");
-const std::string light_f_shader("../projects/01-bouncing_ball/resources/shaders/light_cube.fs");
 
+const std::string block_v_shader("../projects/04-ray-casting/resources/shaders/vertex.vs");
+const std::string block_f_shader("../projects/04-ray-casting/resources/shaders/fragment.fs");
+const std::string light_v_shader("../projects/04-ray-casting/resources/shaders/light_cube.vs");
+const std::string light_f_shader("../projects/04-ray-casting/resources/shaders/light_cube.fs");
+
+
+void initSpheres(std::vector<Sphere>& spheres, float extent){
+    for (std::vector<Sphere>::iterator it=spheres.begin(); it != spheres.end(); ++it){
+        it->pos = glm::ballRand(extent);
+        it->prev_pos = it->pos;
+
+        // Set other spheres properties
+        it->vel = glm::ballRand(0.5f);
+        it->color = glm::linearRand(glm::vec3(0.0f), glm::vec3(1.0f));
+        it->radius = glm::linearRand(0.1f, 0.2f);
+        it->m = (4/3) * M_PI * it->radius * it->radius * it->radius;
+    }
+}
+
+int runRender(int argc, char** argv){
+    int n = argc > 3 ? std::atoi(argv[3]) : 8;
+    int width = argc > 5 ? std::atoi(argv[4]) : 0;
+    int height = argc > 5 ? std::atoi(argv[5]) : 0;
+    // atoi gives 0 for garbage and a negative value would wrap around, the caps keep the
+    // spheres and the image within memory
+    bool bad_size = argc > 5 && (width <= 0 || width > 16384 || height <= 0 || height > 16384);
+    if (argc < 3 || n <= 0 || n > 10000000 || bad_size) {
+        std::cout << "usage: " << argv[0] << " --render <output.ppm> [n_spheres] [width] [height]" << std::endl;
+        return 1;
+    }
+    unsigned int n_spheres = n;
+
+    RenderSettings settings;
+    if (argc > 5) {
+        settings.width = width;
+        settings.height = height;
+    }
+
+    // Keep the density of the interactive scene: the ball grows with the number of spheres
+    float extent = std::cbrt(std::max(n_spheres, 8u) / 8.0f);
+    std::vector<Sphere> spheres(n_spheres);
+    initSpheres(spheres, extent);
+    settings.lightPos *= extent;
+
+    Camera view(glm::vec3(0.0f, 0.0f, 3.0f * extent));
+
+    auto start = std::chrono::steady_clock::now();
+    BVH bvh;
+    bvh.build(spheres);
+    auto built = std::chrono::steady_clock::now();
+    Image image;
+    render(view, spheres, bvh, settings, image);
+    auto done = std::chrono::steady_clock::now();
+
+    std::cout << settings.width << "x" << settings.height << ", " << n_spheres << " spheres: BVH "
+              << std::chrono::duration<float, std::milli>(built - start).count() << " ms, render "
+              << std::chrono::duration<float, std::milli>(done - built).count() << " ms on "
+              << hardwareThreads() << " threads" << std::endl;
+    return image.writePPM(argv[2]) ? 0 : 1;
+}
+
+// Square pyramid of boxes of 0.1 on a static ground, each box resting on 4 boxes below. The boxes
+// start at rest, exactly touching: n_levels = 14 gives 14^2 + 13^2 + ... + 1 = 1015 boxes.
+void initStack(std::vector<Cube>& boxes, unsigned int n_levels){
+    const float size = 0.1f;
+
+    // The ground is body 0, its top face at y = 0
+    Cube ground(glm::vec3(n_levels * size + 1.0f, 1.0f, n_levels * size + 1.0f));
+    ground.pos = glm::vec3(0.0f, -0.5f, 0.0f);
+    ground.color = glm::vec3(0.5f);
+    boxes.assign(1, ground);
+
+    for (unsigned int level = 0; level != n_levels; ++level){
+        unsigned int side = n_levels - level;
+        for (unsigned int i = 0; i != side * side; ++i){
+            Cube box(glm::vec3(1.0f) * size);
+            box.pos.x = (i % side - 0.5f * (side - 1)) * size;
+            box.pos.y = (level + 0.5f) * size;
+            box.pos.z = (i / side - 0.5f * (side - 1)) * size;
+            box.color = glm::linearRand(glm::vec3(0.0f), glm::vec3(1.0f));
+            box.m = size * size * size;
+            boxes.push_back(box);
+        }
+    }
+}
+
+int runStack(int argc, char** argv){
+    unsigned int n_levels = argc > 2 ? std::atoi(argv[2]) : 14;
+    RigidWorld world;
+    if (argc > 3)
+        world.iterations = std::atoi(argv[3]);
+    world.warmStart = !(argc > 4 && std::string(argv[4]) == "--no-warm-start");
+    if (n_levels == 0 || n_levels > 100 || world.iterations == 0) {
+        std::cout << "usage: " << argv[0] << " --stack [n_levels] [iterations] [--no-warm-start]" << std::endl;
+        return 1;
+    }
+
+    std::vector<Cube> boxes;
+    std::vector<Sphere> spheres;
+    initStack(boxes, n_levels);
+    size_t n_boxes = boxes.size() - 1;
+
+    // Settled once no point of a box moves faster than rest_speed for a whole second
+    const float dt = 1.0f / 60.0f;
+    const unsigned int max_steps = 1200;
+    const unsigned int rest_steps = 60;
+    const float rest_speed = 1e-2f;
+
+    unsigned int steps = 0, calm = 0;
+    float speed = 0.0f;
+    double mean = 0.0;
+    auto start = std::chrono::steady_clock::now();
+    while (steps != max_steps && calm != rest_steps){
+        world.step(boxes, spheres, dt);
+        ++steps;
+
+        speed = 0.0f;
+        mean = 0.0;
+        for (std::vector<Cube>::const_iterator it = boxes.begin() + 1; it != boxes.end(); ++it){
+            float v = glm::length(it->vel) + 0.5f * glm::length(it->size) * glm::length(it->angVel);
+            speed = std::max(speed, v);
+            mean += v;
+        }
+        mean /= n_boxes;
+        calm = speed < rest_speed ? calm + 1 : 0;
+    }
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    // How far the top box sank into the ones below
+    const Cube& top = boxes.back();
+    float sink = (n_levels - 0.5f) * top.size.y - top.pos.y;
+
+    std::cout << n_boxes << " boxes, " << world.iterations << " iterations per step, warm start "
+              << (world.warmStart ? "on" : "off") << ": ";
+    if (calm == rest_steps)
+        std::cout << "settled after " << steps - rest_steps << " steps (" << (steps - rest_steps) * world.iterations << " iterations)";
+    else
+        std::cout << "not settled after " << steps << " steps";
+    std::cout << std::endl << "resting velocity " << mean << " m/s mean, " << speed << " m/s max, top sank "
+              << sink << " m, " << world.nContacts() << " contacts, " << ms / steps << " ms per step" << std::endl;
+    return calm == rest_steps ? 0 : 1;
+}
+
+// Sim side of a frame, shared by the window loop and the headless replay: picking and dragging.
+// pick() gives the sphere under camera.ray (or nullptr), it is only asked while nothing is held.
+template<typename Pick>
+void updateFrame(std::vector<Sphere>& spheres, Sphere*& ClickedObject, float& clicked_distance, Pick pick){
+    if ((camera.ray != nullptr) && (ClickedObject == nullptr)){
+        ClickedObject = pick();
+        session.add(REPLAY_PICK, ClickedObject != nullptr ? (int)(ClickedObject - &spheres[0]) : -1);
+        if (ClickedObject != nullptr)
+            clicked_distance = glm::length(ClickedObject->pos - camera.Position);
+    }
+
+    if ((camera.ray != nullptr) && (ClickedObject != nullptr)){
+        // Move object to mouse position in the plane whose normal goes through the object position and perpendicular to the camera looking direction
+        ClickedObject->pos = camera.Position + clicked_distance * camera.Front;
+    }
+    if ((camera.ray == nullptr) && (ClickedObject != nullptr))
+        ClickedObject = nullptr;
+}
+
+int runReplay(int argc, char** argv){
+    if (argc < 3) {
+        std::cout << "usage: " << argv[0] << " --replay <session.log>" << std::endl;
+        return 1;
+    }
+    ReplayLog log;
+    if (!log.load(argv[2]))
+        return 1;
+
+    std::srand(log.seed);
+    std::vector<Sphere> spheres(log.n_spheres);
+    initSpheres(spheres, 1.0f);
+    BVH bvh;
+    bvh.build(spheres);
+
+    Sphere *ClickedObject = nullptr;
+    float clicked_distance = 0.0f;
+    int picked = -1;
+
+    // Time spent in the update of every frame, the part a profiler wants to look at
+    unsigned long n_frames = 0, slowest = 0;
+    double total = 0.0, worst = 0.0;
+
+    const std::vector<ReplayEvent>& events = log.getEvents();
+    for (std::vector<ReplayEvent>::const_iterator it = events.begin(); it != events.end(); ++it) {
+        switch (it->type) {
+            case REPLAY_KEY: camera.ProcessKeyboard((Camera_Movement)it->i, it->a); break;
+            case REPLAY_MOUSE: camera.ProcessMouseMovement(it->a, it->b); break;
+            case REPLAY_SCROLL: camera.ProcessMouseScroll(it->a); break;
+            case REPLAY_CLICK: camera.ProcessMouseClick(it->i != 0); break;
+            case REPLAY_PICK: picked = it->i; break;
+            case REPLAY_FRAME: {
+                lastFrame = it->a;
+                deltaTime = it->b;
+
+                auto start = std::chrono::steady_clock::now();
+                bvh.refit(spheres);
+                updateFrame(spheres, ClickedObject, clicked_distance, [&]() -> Sphere* {
+                    return picked >= 0 && picked < (int)spheres.size() ? &spheres[picked] : nullptr;
+                });
+                double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+                total += ms;
+                if (ms > worst) {
+                    worst = ms;
+                    slowest = n_frames;
+                }
+                ++n_frames;
+                break;
+            }
+        }
+    }
+
+    std::cout << n_frames << " frames, update " << total << " ms total, " << (n_frames ? total / n_frames : 0.0)
+              << " ms mean, " << worst << " ms worst (frame " << slowest << ")" << std::endl;
+    if (log.getChecksum() != 0 && log.getChecksum() != stateChecksum(spheres)) {
+        std::cout << "ERROR::REPLAY::DIVERGED final state differs from the recorded session" << std::endl;
+        return 1;
+    }
+    return 0;
+}
 
 int main(int argc, char** argv)
 {
+    if (argc > 1 && std::string(argv[1]) == "--render")
+        return runRender(argc, argv);
+
+    if (argc > 1 && std::string(argv[1]) == "--replay")
+        return runReplay(argc, argv);
+
+    if (argc > 1 && std::string(argv[1]) == "--stack")
+        return runStack(argc, argv);
+
+    // --gpu-picking: pick through the id buffer instead of casting camera.ray on the CPU
+    // --record-session <file>: log the seed and every input for --replay
+    bool gpu_picking = false;
+    std::string session_file;
+    for (int i = 1; i < argc; ++i) {
+        if (std::string(argv[i]) == "--gpu-picking")
+            gpu_picking = true;
+        else if (std::string(argv[i]) == "--record-session" && i + 1 < argc)
+            session_file = argv[++i];
+    }
+
     std::string title = "PhysicsSim";
     unsigned int width = 1920;
     unsigned int height = 1080;
@@ -69,19 +318,15 @@ int main(int argc, char** argv)
     axle.color = glm::vec3(1.0f, 0.5f, 0.31f);
 
 
+    // glm::linearRand and ballRand draw from std::rand
+    unsigned int seed = 1;
+    std::srand(seed);
+
     unsigned int n_spheres = 8;
     std::vector<Sphere> spheres(n_spheres);
-
-    for (std::vector<Sphere>::iterator it=spheres.begin(); it != spheres.end(); ++it){
-        it->pos = glm::ballRand(1.0f);
-        it->prev_pos = it->pos;
-
-        // Set other spheres properties
-        it->vel = glm::ballRand(0.5f);
-        it->color = glm::linearRand(glm::vec3(0.0f), glm::vec3(1.0f));
-        it->radius = glm::linearRand(0.1f, 0.2f);
-        it->m = (4/3) * M_PI * it->radius * it->radius * it->radius;
-    }
+    initSpheres(spheres, 1.0f);
+    if (!session_file.empty())
+        session.record(session_file, seed, n_spheres);
 
     // Transforms
     glm::mat4 proj;
@@ -91,7 +336,16 @@ int main(int argc, char** argv)
     glEnable(GL_DEPTH_TEST);
     unsigned int n_substeps = 100;
 
+    // Acceleration structure for picking, refitted every frame
+    BVH bvh;
+    bvh.build(spheres);
+
+    int fb_width, fb_height;
+    glfwGetFramebufferSize(window, &fb_width, &fb_height);
+    GpuPicker picker(fb_width, fb_height);
+
     Sphere *ClickedObject = nullptr;
+    float clicked_distance = 0.0f;
     // render loop
     // -----------
     while (!glfwWindowShouldClose(window))
@@ -108,25 +362,33 @@ int main(int argc, char** argv)
         processInput(window);
 
         // Find object if clicked and move it accordingly
-        glm::vec3 clicked_object_pos;
-        if ((camera.ray != nullptr) && (ClickedObject == nullptr)){
-            // TODO: Check for intersection with correct object
-            ClickedObject = ObjectRayCast(*camera.ray, spheres);
-            //ClickedObject = &sphere;
-            clicked_object_pos = ClickedObject->pos;
-        }
+        bvh.refit(spheres);
+        updateFrame(spheres, ClickedObject, clicked_distance, [&]() -> Sphere* {
+            if (gpu_picking) {
+                // Id under the center of the screen drawn a frame ago, 0 is the background
+                unsigned int id;
+                if (picker.poll(id) && id != 0 && id <= spheres.size())
+                    return &spheres[id - 1];
+                return nullptr;
+            }
+            RayHit hit = ObjectRayCast(*camera.ray, spheres, bvh);
+            return hit.hit() ? &spheres[hit.index] : nullptr;
+        });
+        session.add(REPLAY_FRAME, 0, time, deltaTime);
 
-        if ((camera.ray != nullptr) && (ClickedObject != nullptr)){
-            // Move object to mouse position in the plane whose normal goes through the object position and perpendicular to the camera looking direction
-            float beta = glm::length(clicked_object_pos - camera.Position);
-            ClickedObject->pos = camera.Position + beta * camera.Front;
-        }
-        if ((camera.ray == nullptr) && (ClickedObject != nullptr))
-            ClickedObject = nullptr;
+        // Readbacks still in flight belong to a finished or released click
+        if ((camera.ray == nullptr) || (ClickedObject != nullptr))
+            picker.cancel();
 
         // rendering commands
-        glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        if (gpu_picking) {
+            glfwGetFramebufferSize(window, &fb_width, &fb_height);
+            picker.resize(fb_width, fb_height);
+            picker.bind(0.2f, 0.3f, 0.3f, 1.0f);
+        } else {
+            glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        }
 
         // Set camera transforms
         proj = glm::perspective(glm::radians(camera.Zoom), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100.0f);
@@ -158,6 +420,7 @@ int main(int argc, char** argv)
                 model = glm::translate(model, it->pos);
                 model = glm::scale(model, glm::vec3(1.0f, 1.0f, 1.0f) * it->radius);
                 blockShader.setMat4f("model", model);
+                blockShader.setUInt("objectId", (unsigned int)(it - spheres.begin()) + 1);
                 mesh_sphere.Draw();
 
                 // Update velocities
@@ -176,12 +439,20 @@ int main(int argc, char** argv)
         lightShader.setMat4f("view", view);
         mesh_cube.Draw();
 
+        if (gpu_picking) {
+            if ((camera.ray != nullptr) && (ClickedObject == nullptr))
+                picker.request(fb_width / 2, fb_height / 2);
+            picker.present();
+        }
+
         // swap buffers and poll IO events (key pressed/released, ...)
         // -----------------------------------------------------------
         glfwSwapBuffers(window);
         glfwPollEvents();
     }
 
+    session.close(stateChecksum(spheres));
+
     // glfw: terminate, clear all previous allocated GLFW resources
     // ------------------------------------------------------------
     glfwDestroyWindow(window);
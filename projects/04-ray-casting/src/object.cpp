@@ -5,6 +5,30 @@
 
 #include "object.hpp"
 
+// Branchless slab test against [-half, half] for a ray already in box space.
+// t is the entry distance, or the exit one when the origin is inside, like Sphere::intersects.
+static bool slab(glm::vec3 half, glm::vec3 O, glm::vec3 invDir, float& t) {
+    glm::vec3 t0 = (-half - O) * invDir;
+    glm::vec3 t1 = (half - O) * invDir;
+    glm::vec3 tnear = glm::min(t0, t1);
+    glm::vec3 tfar = glm::max(t0, t1);
+    float enter = glm::max(glm::max(tnear.x, tnear.y), tnear.z);
+    float exit = glm::min(glm::min(tfar.x, tfar.y), tfar.z);
+    t = enter >= 0.0f ? enter : exit;
+    return (enter <= exit) & (exit >= 0.0f);
+}
+
+bool Cube::intersects(const Ray& r, float& t) const {
+    // Rotate the ray into box space, lengths are kept so t is the same in world space
+    glm::quat inv = glm::conjugate(orient);
+    glm::vec3 dir = inv * r.dir;
+    return slab(0.5f * size, inv * (r.O - pos), 1.0f / dir, t);
+};
+
+bool Cube::intersectsAABB(const Ray& r, float& t) const {
+    return slab(0.5f * size, r.O - pos, r.invDir, t);
+};
+
 MeshCube::MeshCube () {
     construct();
     setup();
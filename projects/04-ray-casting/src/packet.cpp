@@ -0,0 +1,161 @@
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <vector>
+
+#include "packet.hpp"
+
+
+void SphereSoA::assign(const std::vector<Sphere>& spheres) {
+    x.resize(spheres.size());
+    y.resize(spheres.size());
+    z.resize(spheres.size());
+    r2.resize(spheres.size());
+    for (size_t i = 0; i != spheres.size(); ++i) {
+        x[i] = spheres[i].pos.x;
+        y[i] = spheres[i].pos.y;
+        z[i] = spheres[i].pos.z;
+        r2[i] = spheres[i].radius * spheres[i].radius;
+    }
+}
+
+void BoxSoA::assign(const std::vector<Cube>& boxes) {
+    std::vector<float>* all[] = {&x, &y, &z, &hx, &hy, &hz, &ux, &uy, &uz, &vx, &vy, &vz, &wx, &wy, &wz};
+    for (std::vector<float>* v : all)
+        v->resize(boxes.size());
+
+    for (size_t i = 0; i != boxes.size(); ++i) {
+        const Cube& b = boxes[i];
+        glm::mat3 R = glm::mat3_cast(b.orient);
+        x[i] = b.pos.x; y[i] = b.pos.y; z[i] = b.pos.z;
+        hx[i] = 0.5f * b.size.x; hy[i] = 0.5f * b.size.y; hz[i] = 0.5f * b.size.z;
+        ux[i] = R[0].x; uy[i] = R[0].y; uz[i] = R[0].z;
+        vx[i] = R[1].x; vy[i] = R[1].y; vz[i] = R[1].z;
+        wx[i] = R[2].x; wy[i] = R[2].y; wz[i] = R[2].z;
+    }
+}
+
+// Slab test in box space on scalars so the box loops vectorize, see Cube::intersects
+static inline float slab(float ox, float oy, float oz, float ix, float iy, float iz, float hx, float hy, float hz, bool& hit) {
+    float t0x = (-hx - ox) * ix, t1x = (hx - ox) * ix;
+    float t0y = (-hy - oy) * iy, t1y = (hy - oy) * iy;
+    float t0z = (-hz - oz) * iz, t1z = (hz - oz) * iz;
+    float enter = std::max(std::max(std::min(t0x, t1x), std::min(t0y, t1y)), std::min(t0z, t1z));
+    float exit = std::min(std::min(std::max(t0x, t1x), std::max(t0y, t1y)), std::max(t0z, t1z));
+    hit = (enter <= exit) & (exit >= 0.0f);
+    return enter >= 0.0f ? enter : exit;
+}
+
+// Nearest hit over n boxes, test(b, hit) returns the slab t of box b.
+// The boxes are spread over LANES independent minimums, merged at the end: a single running
+// minimum with its index is a dependency chain the compiler refuses to vectorize.
+template<typename F>
+static RayHit nearest(size_t n, F test) {
+    const int LANES = 8;
+    alignas(32) float best[LANES];
+    alignas(32) int index[LANES];
+    for (int l = 0; l != LANES; ++l) {
+        best[l] = std::numeric_limits<float>::max();
+        index[l] = -1;
+    }
+
+    for (size_t b = 0; b < n; b += LANES) {
+        int lanes = (int)std::min<size_t>(LANES, n - b);
+        if (lanes == LANES) {
+            for (int l = 0; l != LANES; ++l) {
+                bool hit;
+                float t = test(b + l, hit);
+                hit = hit & (t < best[l]);
+                best[l] = hit ? t : best[l];
+                index[l] = hit ? (int)(b + l) : index[l];
+            }
+        } else {
+            for (int l = 0; l != lanes; ++l) {
+                bool hit;
+                float t = test(b + l, hit);
+                if (hit && t < best[l]) {
+                    best[l] = t;
+                    index[l] = (int)(b + l);
+                }
+            }
+        }
+    }
+
+    RayHit ret = {-1, std::numeric_limits<float>::max()};
+    for (int l = 0; l != LANES; ++l) {
+        if (index[l] >= 0 && (best[l] < ret.t || (best[l] == ret.t && index[l] < ret.index))) {
+            ret.t = best[l];
+            ret.index = index[l];
+        }
+    }
+    return ret;
+}
+
+RayHit intersectAABB(const Ray& ray, const BoxSoA& boxes) {
+    const float ox = ray.O.x, oy = ray.O.y, oz = ray.O.z;
+    const float ix = ray.invDir.x, iy = ray.invDir.y, iz = ray.invDir.z;
+
+    return nearest(boxes.size(), [&](size_t b, bool& hit) {
+        return slab(ox - boxes.x[b], oy - boxes.y[b], oz - boxes.z[b], ix, iy, iz,
+                    boxes.hx[b], boxes.hy[b], boxes.hz[b], hit);
+    });
+}
+
+RayHit intersectOBB(const Ray& ray, const BoxSoA& boxes) {
+    return nearest(boxes.size(), [&](size_t b, bool& hit) {
+        // Project origin and direction on the box axes
+        float px = ray.O.x - boxes.x[b], py = ray.O.y - boxes.y[b], pz = ray.O.z - boxes.z[b];
+        float ox = boxes.ux[b] * px + boxes.uy[b] * py + boxes.uz[b] * pz;
+        float oy = boxes.vx[b] * px + boxes.vy[b] * py + boxes.vz[b] * pz;
+        float oz = boxes.wx[b] * px + boxes.wy[b] * py + boxes.wz[b] * pz;
+        float dx = boxes.ux[b] * ray.dir.x + boxes.uy[b] * ray.dir.y + boxes.uz[b] * ray.dir.z;
+        float dy = boxes.vx[b] * ray.dir.x + boxes.vy[b] * ray.dir.y + boxes.vz[b] * ray.dir.z;
+        float dz = boxes.wx[b] * ray.dir.x + boxes.wy[b] * ray.dir.y + boxes.wz[b] * ray.dir.z;
+
+        return slab(ox, oy, oz, 1.0f / dx, 1.0f / dy, 1.0f / dz, boxes.hx[b], boxes.hy[b], boxes.hz[b], hit);
+    });
+}
+
+template<int W>
+void intersect(RayPacket<W>& packet, const SphereSoA& spheres) {
+    alignas(64) float best[W];
+    alignas(64) int index[W];
+    for (int l = 0; l != W; ++l) {
+        best[l] = std::numeric_limits<float>::max();
+        index[l] = -1;
+    }
+
+    // One sphere against all the lanes: the lane loop is branch free so it vectorizes
+    for (size_t s = 0; s != spheres.size(); ++s) {
+        const float cx = spheres.x[s], cy = spheres.y[s], cz = spheres.z[s], r2 = spheres.r2[s];
+
+        for (int l = 0; l != W; ++l) {
+            // t^2 + 2 b t + c = 0, see Sphere::intersects
+            float ocx = packet.ox[l] - cx;
+            float ocy = packet.oy[l] - cy;
+            float ocz = packet.oz[l] - cz;
+            float b = packet.dx[l] * ocx + packet.dy[l] * ocy + packet.dz[l] * ocz;
+            float c = ocx * ocx + ocy * ocy + ocz * ocz - r2;
+            float delta = b * b - c;
+
+            float root = std::sqrt(std::max(delta, 0.0f));
+            float t0 = -b - root;
+            float t = t0 >= 0.0f ? t0 : -b + root;
+
+            // & and not &&: no short circuit, no branch
+            bool hit = (delta >= 0.0f) & (t >= 0.0f) & (t < best[l]);
+            best[l] = hit ? t : best[l];
+            index[l] = hit ? (int)s : index[l];
+        }
+    }
+
+    for (int l = 0; l != W; ++l) {
+        packet.t[l] = best[l];
+        packet.index[l] = index[l];
+    }
+}
+
+template void intersect<8>(RayPacket<8>&, const SphereSoA&);
+template void intersect<16>(RayPacket<16>&, const SphereSoA&);
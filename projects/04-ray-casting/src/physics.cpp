@@ -4,9 +4,9 @@
 #include <iostream>
 
 
-float energy(glm::vec3 pos, glm::vec3 v){
+float energy(const Sphere& s){
     glm::vec3 g(0.0f, -10.f, 0.0f);
-    return -g.y*pos.y + 0.5 * dot(v, v);
+    return s.m * (-g.y*s.pos.y + 0.5f * glm::dot(s.vel, s.vel));
 };
 
 
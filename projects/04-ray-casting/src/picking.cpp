@@ -0,0 +1,143 @@
+#include <glad/glad.h>
+
+#include <iostream>
+
+#include "picking.hpp"
+
+
+GpuPicker::GpuPicker(unsigned int width, unsigned int height): width(width), height(height), next(0) {
+    glGenBuffers(N_PBO, PBO);
+    for (int i = 0; i != N_PBO; ++i) {
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, PBO[i]);
+        glBufferData(GL_PIXEL_PACK_BUFFER, sizeof(GLuint), NULL, GL_STREAM_READ);
+        fence[i] = nullptr;
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    create();
+};
+
+GpuPicker::~GpuPicker() {
+    destroy();
+    cancel();
+    glDeleteBuffers(N_PBO, PBO);
+};
+
+void GpuPicker::create() {
+    glGenFramebuffers(1, &FBO);
+    glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+
+    glGenTextures(1, &colorTex);
+    glBindTexture(GL_TEXTURE_2D, colorTex);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, colorTex, 0);
+
+    // Integer textures cannot be filtered
+    glGenTextures(1, &idTex);
+    glBindTexture(GL_TEXTURE_2D, idTex);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_R32UI, width, height, 0, GL_RED_INTEGER, GL_UNSIGNED_INT, NULL);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, idTex, 0);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    glGenRenderbuffers(1, &depthRBO);
+    glBindRenderbuffer(GL_RENDERBUFFER, depthRBO);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, width, height);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, depthRBO);
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+    const GLenum buffers[] = {GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1};
+    glDrawBuffers(2, buffers);
+
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+        std::cout << "ERROR::FRAMEBUFFER::PICKING_NOT_COMPLETE" << std::endl;
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+};
+
+void GpuPicker::destroy() {
+    glDeleteFramebuffers(1, &FBO);
+    glDeleteTextures(1, &colorTex);
+    glDeleteTextures(1, &idTex);
+    glDeleteRenderbuffers(1, &depthRBO);
+};
+
+void GpuPicker::resize(unsigned int width, unsigned int height) {
+    if (width == this->width && height == this->height)
+        return;
+    this->width = width;
+    this->height = height;
+    destroy();
+    create();
+};
+
+void GpuPicker::bind(float r, float g, float b, float a) {
+    glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+    const GLfloat color[] = {r, g, b, a};
+    const GLuint none[] = {0, 0, 0, 0};
+    glClearBufferfv(GL_COLOR, 0, color);
+    glClearBufferuiv(GL_COLOR, 1, none);
+    glClear(GL_DEPTH_BUFFER_BIT);
+};
+
+void GpuPicker::present() {
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, FBO);
+    glReadBuffer(GL_COLOR_ATTACHMENT0);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+    glBlitFramebuffer(0, 0, width, height, 0, 0, width, height, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+};
+
+void GpuPicker::request(unsigned int x, unsigned int y) {
+    if (x >= width || y >= height)
+        return;
+
+    // Still in flight from two frames ago: drop it, the next poll reads the newer one
+    if (fence[next] != nullptr)
+        glDeleteSync(fence[next]);
+
+    // Asynchronous: with a PBO bound glReadPixels only queues the copy
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, FBO);
+    glReadBuffer(GL_COLOR_ATTACHMENT1);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, PBO[next]);
+    glReadPixels(x, height - 1 - y, 1, 1, GL_RED_INTEGER, GL_UNSIGNED_INT, 0);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+
+    fence[next] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    next = (next + 1) % N_PBO;
+};
+
+bool GpuPicker::poll(unsigned int& id) {
+    // Oldest request first
+    for (int k = 0; k != N_PBO; ++k) {
+        int i = (next + k) % N_PBO;
+        if (fence[i] == nullptr)
+            continue;
+
+        GLenum status = glClientWaitSync(fence[i], 0, 0);
+        if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED)
+            return false;
+        glDeleteSync(fence[i]);
+        fence[i] = nullptr;
+
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, PBO[i]);
+        GLuint* data = (GLuint*)glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, sizeof(GLuint), GL_MAP_READ_BIT);
+        if (data != nullptr) {
+            id = *data;
+            glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+        }
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        return data != nullptr;
+    }
+    return false;
+};
+
+void GpuPicker::cancel() {
+    for (int i = 0; i != N_PBO; ++i) {
+        if (fence[i] != nullptr)
+            glDeleteSync(fence[i]);
+        fence[i] = nullptr;
+    }
+};
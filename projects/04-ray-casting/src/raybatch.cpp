@@ -0,0 +1,82 @@
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+#include "parallel.hpp"
+#include "raybatch.hpp"
+
+
+// 5 bits of x, y and z interleaved into 15 bits
+static uint32_t morton5(glm::vec3 p) {
+    uint32_t code = 0;
+    uint32_t x = (uint32_t)glm::clamp(p.x * 32.0f, 0.0f, 31.0f);
+    uint32_t y = (uint32_t)glm::clamp(p.y * 32.0f, 0.0f, 31.0f);
+    uint32_t z = (uint32_t)glm::clamp(p.z * 32.0f, 0.0f, 31.0f);
+    for (int bit = 4; bit >= 0; --bit)
+        code = (code << 3) | (((x >> bit) & 1) << 2) | (((y >> bit) & 1) << 1) | ((z >> bit) & 1);
+    return code;
+}
+
+void RayBatch::sortRays(const glm::vec3* origins, const glm::vec3* dirs, size_t n) {
+    keys.resize(n);
+    order.resize(n);
+    tmp_keys.resize(n);
+    tmp_order.resize(n);
+
+    glm::vec3 lo(std::numeric_limits<float>::max()), hi(-std::numeric_limits<float>::max());
+    for (size_t i = 0; i != n; ++i) {
+        lo = glm::min(lo, origins[i]);
+        hi = glm::max(hi, origins[i]);
+    }
+    glm::vec3 scale = 1.0f / glm::max(hi - lo, glm::vec3(1e-6f));
+
+    // Origin first, then direction: rays from one sensor only differ by their direction
+    parallel_for(0, n, grain, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i != end; ++i) {
+            keys[i] = (morton5((origins[i] - lo) * scale) << 15) | morton5(0.5f * dirs[i] + 0.5f);
+            order[i] = (uint32_t)i;
+        }
+    });
+
+    // LSD radix sort on the 30 bits, 3 passes of 10 bits
+    const int BITS = 10;
+    for (int shift = 0; shift < 30; shift += BITS) {
+        std::vector<size_t> count((1 << BITS) + 1, 0);
+        for (size_t i = 0; i != n; ++i)
+            ++count[((keys[i] >> shift) & ((1 << BITS) - 1)) + 1];
+        for (size_t b = 1; b != count.size(); ++b)
+            count[b] += count[b - 1];
+        for (size_t i = 0; i != n; ++i) {
+            size_t dst = count[(keys[i] >> shift) & ((1 << BITS) - 1)]++;
+            tmp_keys[dst] = keys[i];
+            tmp_order[dst] = order[i];
+        }
+        keys.swap(tmp_keys);
+        order.swap(tmp_order);
+    }
+}
+
+void RayBatch::cast(const glm::vec3* origins, const glm::vec3* dirs, size_t n,
+                    const std::vector<Sphere>& spheres, const BVH& bvh, float* t, int* index) {
+    if (sort) {
+        sortRays(origins, dirs, n);
+    } else {
+        order.resize(n);
+        for (size_t i = 0; i != n; ++i)
+            order[i] = (uint32_t)i;
+    }
+
+    parallel_for(0, n, grain, [&](size_t begin, size_t end) {
+        Ray ray(origins[order[begin]], dirs[order[begin]]);
+        for (size_t k = begin; k != end; ++k) {
+            uint32_t i = order[k];
+            ray(origins[i], dirs[i]);
+            RayHit hit = bvh.intersect(ray, spheres);
+            t[i] = hit.t;
+            index[i] = hit.index;
+        }
+    });
+}
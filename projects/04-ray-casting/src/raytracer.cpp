@@ -0,0 +1,91 @@
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "camera.hpp"
+#include "parallel.hpp"
+#include "raytracer.hpp"
+
+
+void Image::resize(unsigned int width, unsigned int height) {
+    this->width = width;
+    this->height = height;
+    rgb.assign(3 * (size_t)width * height, 0);
+}
+
+bool Image::writePPM(const std::string& filename) const {
+    std::ofstream file(filename, std::ios::binary);
+    if (!file) {
+        std::cout << "ERROR::IMAGE::FILE_NOT_SUCCESSFULLY_OPENED " << filename << std::endl;
+        return false;
+    }
+    file << "P6\n" << width << " " << height << "\n255\n";
+    file.write((const char*)rgb.data(), rgb.size());
+    return (bool)file;
+}
+
+// Same lighting as fragment.fs
+static glm::vec3 phong(glm::vec3 pos, glm::vec3 normal, glm::vec3 color, glm::vec3 viewPos, const RenderSettings& settings) {
+    glm::vec3 ambient = 0.3f * settings.lightColor;
+
+    glm::vec3 lightDir = glm::normalize(settings.lightPos - pos);
+    float diff = std::max(glm::dot(normal, lightDir), 0.0f);
+    glm::vec3 diffuse = diff * settings.lightColor;
+
+    glm::vec3 viewDir = glm::normalize(viewPos - pos);
+    glm::vec3 reflectDir = glm::reflect(-lightDir, normal);
+    float spec = std::pow(std::max(glm::dot(viewDir, reflectDir), 0.0f), 32.0f);
+    glm::vec3 specular = 0.5f * spec * settings.lightColor;
+
+    return (ambient + diffuse + specular) * color;
+}
+
+void render(const Camera& camera, const std::vector<Sphere>& spheres, const BVH& bvh,
+            const RenderSettings& settings, Image& image) {
+    image.resize(settings.width, settings.height);
+
+    // Pixel (x, y) looks along Front + u Right + v Up, matching glm::perspective with camera.Zoom
+    float v_max = std::tan(glm::radians(camera.Zoom) / 2.0f);
+    float u_max = v_max * (float)settings.width / (float)settings.height;
+    glm::vec3 du = (2.0f * u_max / settings.width) * camera.Right;
+    glm::vec3 dv = (-2.0f * v_max / settings.height) * camera.Up;
+    glm::vec3 corner = camera.Front - u_max * camera.Right + v_max * camera.Up + 0.5f * (du + dv);
+
+    unsigned int tile = std::max(settings.tile, 1u);
+    unsigned int n_x = (settings.width + tile - 1) / tile;
+    unsigned int n_y = (settings.height + tile - 1) / tile;
+
+    parallel_for(0, (size_t)n_x * n_y, 1, [&](size_t begin, size_t end) {
+        Ray ray(camera.Position, camera.Front);
+        for (size_t i = begin; i != end; ++i) {
+            unsigned int x0 = (i % n_x) * tile, y0 = (i / n_x) * tile;
+            unsigned int x1 = std::min(x0 + tile, settings.width), y1 = std::min(y0 + tile, settings.height);
+
+            for (unsigned int y = y0; y != y1; ++y) {
+                unsigned char* out = &image.rgb[3 * ((size_t)y * settings.width + x0)];
+                for (unsigned int x = x0; x != x1; ++x, out += 3) {
+                    ray(camera.Position, glm::normalize(corner + (float)x * du + (float)y * dv));
+
+                    glm::vec3 color = settings.background;
+                    RayHit hit = bvh.intersect(ray, spheres);
+                    if (hit.hit()) {
+                        const Sphere& s = spheres[hit.index];
+                        glm::vec3 pos = ray.O + hit.t * ray.dir;
+                        color = phong(pos, (pos - s.pos) / s.radius, s.color, camera.Position, settings);
+                    }
+
+                    color = glm::clamp(color, glm::vec3(0.0f), glm::vec3(1.0f));
+                    out[0] = (unsigned char)(255.0f * color.r + 0.5f);
+                    out[1] = (unsigned char)(255.0f * color.g + 0.5f);
+                    out[2] = (unsigned char)(255.0f * color.b + 0.5f);
+                }
+            }
+        }
+    });
+}
@@ -0,0 +1,80 @@
+#include <glm/glm.hpp>
+
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "replay.hpp"
+
+static const char REPLAY_MAGIC[8] = {'P', 'H', 'Y', 'S', 'R', 'P', 'L', 'Y'};
+
+
+ReplayLog::ReplayLog(): seed(1), n_spheres(0), checksum(0) {};
+
+bool ReplayLog::record(const std::string& filename, unsigned int seed, unsigned int n_spheres) {
+    this->seed = seed;
+    this->n_spheres = n_spheres;
+    file.open(filename, std::ios::binary | std::ios::trunc);
+    if (!file) {
+        std::cout << "ERROR::REPLAY::FILE_NOT_SUCCESSFULLY_OPENED " << filename << std::endl;
+        return false;
+    }
+    file.write(REPLAY_MAGIC, sizeof(REPLAY_MAGIC));
+    file.write((const char*)&seed, sizeof(seed));
+    file.write((const char*)&n_spheres, sizeof(n_spheres));
+    return true;
+};
+
+void ReplayLog::add(Replay_Event type, int i, float a, float b) {
+    if (!recording())
+        return;
+    ReplayEvent event = {(uint32_t)type, i, a, b};
+    file.write((const char*)&event, sizeof(event));
+};
+
+void ReplayLog::close(uint64_t checksum) {
+    if (!recording())
+        return;
+    add(REPLAY_END);
+    file.write((const char*)&checksum, sizeof(checksum));
+    file.close();
+};
+
+bool ReplayLog::load(const std::string& filename) {
+    std::ifstream in(filename, std::ios::binary);
+    char magic[sizeof(REPLAY_MAGIC)];
+    if (!in.read(magic, sizeof(magic)) || std::memcmp(magic, REPLAY_MAGIC, sizeof(magic)) != 0) {
+        std::cout << "ERROR::REPLAY::NOT_A_SESSION_LOG " << filename << std::endl;
+        return false;
+    }
+    in.read((char*)&seed, sizeof(seed));
+    in.read((char*)&n_spheres, sizeof(n_spheres));
+
+    events.clear();
+    checksum = 0;
+    ReplayEvent event;
+    while (in.read((char*)&event, sizeof(event))) {
+        if (event.type == REPLAY_END) {
+            in.read((char*)&checksum, sizeof(checksum));
+            return true;
+        }
+        events.push_back(event);
+    }
+    // Session that did not exit cleanly: replay what is there
+    std::cout << "WARNING::REPLAY::TRUNCATED " << events.size() << " events" << std::endl;
+    return true;
+};
+
+uint64_t stateChecksum(const std::vector<Sphere>& spheres) {
+    uint64_t hash = 14695981039346656037ull;
+    for (std::vector<Sphere>::const_iterator it = spheres.begin(); it != spheres.end(); ++it) {
+        const unsigned char* bytes = (const unsigned char*)&it->pos;
+        for (size_t k = 0; k != sizeof(it->pos); ++k) {
+            hash ^= bytes[k];
+            hash *= 1099511628211ull;
+        }
+    }
+    return hash;
+}
@@ -0,0 +1,538 @@
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <unordered_map>
+#include <vector>
+
+#include "rigidbody.hpp"
+
+
+glm::mat3 invInertiaWorld(const Cube& box) {
+    if (box.m <= 0.0f)
+        return glm::mat3(0.0f);
+
+    // Solid box: I = m/12 * (h^2 + d^2, w^2 + d^2, w^2 + h^2), size holds the full extents
+    glm::vec3 s2 = box.size * box.size;
+    glm::vec3 I = box.m / 12.0f * glm::vec3(s2.y + s2.z, s2.x + s2.z, s2.x + s2.y);
+
+    glm::mat3 R = glm::mat3_cast(box.orient);
+    glm::mat3 invILocal(0.0f);
+    invILocal[0][0] = 1.0f / I.x;
+    invILocal[1][1] = 1.0f / I.y;
+    invILocal[2][2] = 1.0f / I.z;
+    return R * invILocal * glm::transpose(R);
+}
+
+
+// --------------------------------------------------------------
+//      Contact generation
+// --------------------------------------------------------------
+struct ClipVertex {
+    glm::vec3 p;
+    uint32_t id;
+};
+
+// Keep the part of the polygon where dot(p, n) <= d (Sutherland-Hodgman).
+// New vertices get an id built from the clip plane and the edge they cut.
+static int clip(const ClipVertex* in, int n_in, glm::vec3 n, float d, uint32_t plane, ClipVertex* out) {
+    int n_out = 0;
+    for (int i = 0; i != n_in; ++i) {
+        const ClipVertex& a = in[i];
+        const ClipVertex& b = in[(i + 1) % n_in];
+        float da = glm::dot(a.p, n) - d;
+        float db = glm::dot(b.p, n) - d;
+
+        if (da <= 0.0f)
+            out[n_out++] = a;
+        if ((da <= 0.0f) != (db <= 0.0f)) {
+            float t = da / (da - db);
+            out[n_out++] = {a.p + t * (b.p - a.p), 0x10 | (plane << 2) | (a.id & 3)};
+        }
+    }
+    return n_out;
+}
+
+// Contacts of the incident box against one face of the reference box.
+// n is the outward normal of the reference face, it points toward the incident box.
+// Feature id: bit 15 reference on b, 14 edge contact (0 here), 13-12 reference axis, 11 reference
+// face on the - side, 10 incident face on the - side, 9-8 incident axis, 4-0 clip vertex. The signs
+// keep the +/- faces of an axis apart, so an impulse is never carried over to the opposite face.
+static int faceContacts(glm::vec3 refPos, const glm::mat3& refR, glm::vec3 refHalf, int refAxis, glm::vec3 n,
+                        glm::vec3 incPos, const glm::mat3& incR, glm::vec3 incHalf, float margin, Contact* out, uint32_t featureBase) {
+    // Incident face: the face of the other box most opposed to n
+    int incAxis = 0;
+    float best = -1.0f;
+    for (int i = 0; i != 3; ++i) {
+        float d = glm::abs(glm::dot(incR[i], n));
+        if (d > best) {
+            best = d;
+            incAxis = i;
+        }
+    }
+    float side = glm::dot(incR[incAxis], n) > 0.0f ? -1.0f : 1.0f;
+    uint32_t refNegative = glm::dot(refR[refAxis], n) < 0.0f ? 1 : 0;
+    uint32_t incNegative = side < 0.0f ? 1 : 0;
+    glm::vec3 incCenter = incPos + side * incHalf[incAxis] * incR[incAxis];
+    glm::vec3 iu = incR[(incAxis + 1) % 3] * incHalf[(incAxis + 1) % 3];
+    glm::vec3 iv = incR[(incAxis + 2) % 3] * incHalf[(incAxis + 2) % 3];
+
+    ClipVertex poly[8] = {
+        {incCenter + iu + iv, 0}, {incCenter - iu + iv, 1},
+        {incCenter - iu - iv, 2}, {incCenter + iu - iv, 3}
+    };
+    int n_poly = 4;
+
+    // Clip against the 4 side planes of the reference face. They are pushed out a little: the
+    // corners of a box of the same size stacked on it sit right on them, rounding would clip them
+    // one frame and not the next, and change their feature ids.
+    glm::vec3 refCenter = refPos + refHalf[refAxis] * n;
+    ClipVertex tmp[8];
+    for (int k = 0; k != 2; ++k) {
+        int axis = (refAxis + 1 + k) % 3;
+        glm::vec3 u = refR[axis];
+        float c = glm::dot(refPos, u);
+        float h = refHalf[axis] * 1.01f;
+        n_poly = clip(poly, n_poly, u, c + h, 2 * k, tmp);
+        n_poly = clip(tmp, n_poly, -u, -c + h, 2 * k + 1, poly);
+        if (n_poly == 0)
+            return 0;
+    }
+
+    // Keep the points below the reference face, or less than margin above it
+    Contact found[8];
+    int n_found = 0;
+    for (int i = 0; i != n_poly; ++i) {
+        float sep = glm::dot(poly[i].p - refCenter, n);
+        if (sep > margin)
+            continue;
+        Contact& c = found[n_found++];
+        c.point = poly[i].p - 0.5f * sep * n;
+        c.depth = -sep;
+        c.feature = featureBase | (uint32_t(refAxis) << 12) | (refNegative << 11) | (incNegative << 10) | (uint32_t(incAxis) << 8) | poly[i].id;
+    }
+    if (n_found <= 4) {
+        std::copy(found, found + n_found, out);
+        return n_found;
+    }
+
+    // Too many points: keep the extremes along the two face axes
+    glm::vec3 u = refR[(refAxis + 1) % 3];
+    glm::vec3 v = refR[(refAxis + 2) % 3];
+    int pick[4] = {0, 0, 0, 0};
+    for (int i = 1; i != n_found; ++i) {
+        if (glm::dot(found[i].point, u) < glm::dot(found[pick[0]].point, u)) pick[0] = i;
+        if (glm::dot(found[i].point, u) > glm::dot(found[pick[1]].point, u)) pick[1] = i;
+        if (glm::dot(found[i].point, v) < glm::dot(found[pick[2]].point, v)) pick[2] = i;
+        if (glm::dot(found[i].point, v) > glm::dot(found[pick[3]].point, v)) pick[3] = i;
+    }
+    int n_out = 0;
+    for (int k = 0; k != 4; ++k) {
+        bool seen = false;
+        for (int j = 0; j != k; ++j)
+            seen = seen || pick[j] == pick[k];
+        if (!seen)
+            out[n_out++] = found[pick[k]];
+    }
+    return n_out;
+}
+
+int collideBoxBox(glm::vec3 posA, glm::quat qA, glm::vec3 halfA, glm::vec3 posB, glm::quat qB, glm::vec3 halfB, float margin, Contact* out) {
+    glm::mat3 Ra = glm::mat3_cast(qA);
+    glm::mat3 Rb = glm::mat3_cast(qB);
+    glm::vec3 d = posB - posA;
+
+    // Separating axis test over the 15 candidate axes
+    float bestFaceA = 1e30f, bestFaceB = 1e30f, bestEdge = 1e30f;
+    int faceAxisA = -1, faceAxisB = -1, edgeAxis = -1;
+    glm::vec3 faceNormalA(0.0f), faceNormalB(0.0f), edgeNormal(0.0f);
+
+    for (int k = 0; k != 15; ++k) {
+        glm::vec3 L;
+        if (k < 3)
+            L = Ra[k];
+        else if (k < 6)
+            L = Rb[k - 3];
+        else {
+            L = glm::cross(Ra[(k - 6) / 3], Rb[(k - 6) % 3]);
+            float len = glm::length(L);
+            // Parallel edges, already covered by the face axes
+            if (len < 1e-5f)
+                continue;
+            L /= len;
+        }
+
+        float ra = 0.0f, rb = 0.0f;
+        for (int i = 0; i != 3; ++i) {
+            ra += halfA[i] * glm::abs(glm::dot(Ra[i], L));
+            rb += halfB[i] * glm::abs(glm::dot(Rb[i], L));
+        }
+        float dist = glm::dot(d, L);
+        float pen = ra + rb - glm::abs(dist);
+        if (pen < -margin)
+            return 0;
+
+        glm::vec3 n = dist < 0.0f ? -L : L;
+        if (k < 3 && pen < bestFaceA) {
+            bestFaceA = pen;
+            faceAxisA = k;
+            faceNormalA = n;
+        } else if (k >= 3 && k < 6 && pen < bestFaceB) {
+            bestFaceB = pen;
+            faceAxisB = k;
+            faceNormalB = n;
+        } else if (k >= 6 && pen < bestEdge) {
+            bestEdge = pen;
+            edgeAxis = k - 6;
+            edgeNormal = n;
+        }
+    }
+
+    // Faces of b and edges must be clearly better to be picked: crossed edges of aligned boxes give
+    // the same axis as a face, and two boxes of the same size tie on their faces. Flipping between
+    // them from frame to frame would change the contact features and lose the warm start.
+    int faceAxis = faceAxisA;
+    float bestFace = bestFaceA;
+    glm::vec3 faceNormal = faceNormalA;
+    if (bestFaceB < 0.95f * bestFaceA - 1e-3f) {
+        faceAxis = faceAxisB;
+        bestFace = bestFaceB;
+        faceNormal = faceNormalB;
+    }
+    if (edgeAxis < 0 || bestEdge >= 0.95f * bestFace - 1e-3f) {
+        int n_out;
+        if (faceAxis < 3) {
+            n_out = faceContacts(posA, Ra, halfA, faceAxis, faceNormal, posB, Rb, halfB, margin, out, 0);
+        } else {
+            // Reference face on b: solve from b and flip the normal back to a -> b
+            n_out = faceContacts(posB, Rb, halfB, faceAxis - 3, -faceNormal, posA, Ra, halfA, margin, out, 0x8000);
+        }
+        for (int i = 0; i != n_out; ++i)
+            out[i].normal = faceNormal;
+        return n_out;
+    }
+
+    // Edge - edge: closest points of the two supporting edges
+    int i = edgeAxis / 3, j = edgeAxis % 3;
+    glm::vec3 n = edgeNormal;
+    // Supporting edges: the side picked on each other axis goes in the feature id (bits 9-4, a then
+    // b) next to the pair of axes (bits 3-0), the 4 parallel edges of an axis stay apart
+    glm::vec3 pA = posA, pB = posB;
+    uint32_t sides = 0;
+    for (int k = 0; k != 3; ++k) {
+        if (k != i) {
+            bool positive = glm::dot(Ra[k], n) > 0.0f;
+            pA += (positive ? 1.0f : -1.0f) * halfA[k] * Ra[k];
+            sides |= uint32_t(positive) << k;
+        }
+        if (k != j) {
+            bool positive = glm::dot(Rb[k], n) > 0.0f;
+            pB -= (positive ? 1.0f : -1.0f) * halfB[k] * Rb[k];
+            sides |= uint32_t(positive) << (3 + k);
+        }
+    }
+    glm::vec3 ea = Ra[i], eb = Rb[j];
+    glm::vec3 r = pA - pB;
+    float b = glm::dot(ea, eb);
+    float denom = 1.0f - b * b;
+    float s = 0.0f, t = 0.0f;
+    if (denom > 1e-6f) {
+        s = (b * glm::dot(eb, r) - glm::dot(ea, r)) / denom;
+        s = glm::clamp(s, -halfA[i], halfA[i]);
+    }
+    t = glm::clamp(glm::dot(eb, pA + s * ea - pB), -halfB[j], halfB[j]);
+
+    out[0].point = 0.5f * (pA + s * ea + pB + t * eb);
+    out[0].normal = n;
+    out[0].depth = bestEdge;
+    out[0].feature = 0x4000 | (sides << 4) | uint32_t(edgeAxis);
+    return 1;
+}
+
+int collideBoxSphere(glm::vec3 posA, glm::quat qA, glm::vec3 halfA, glm::vec3 center, float radius, float margin, Contact* out) {
+    // Work in the box frame
+    glm::vec3 c = glm::conjugate(qA) * (center - posA);
+    glm::vec3 q = glm::clamp(c, -halfA, halfA);
+    glm::vec3 diff = c - q;
+    float dist2 = glm::dot(diff, diff);
+
+    glm::vec3 nLocal;
+    float depth;
+    uint32_t feature;
+    if (dist2 > 0.0f) {
+        if (dist2 > (radius + margin) * (radius + margin))
+            return 0;
+        float dist = glm::sqrt(dist2);
+        nLocal = diff / dist;
+        depth = radius - dist;
+        feature = 0;
+    } else {
+        // Center inside the box: push out through the closest face
+        int axis = 0;
+        float best = 1e30f;
+        for (int i = 0; i != 3; ++i) {
+            float d = halfA[i] - glm::abs(c[i]);
+            if (d < best) {
+                best = d;
+                axis = i;
+            }
+        }
+        nLocal = glm::vec3(0.0f);
+        nLocal[axis] = c[axis] < 0.0f ? -1.0f : 1.0f;
+        q[axis] = nLocal[axis] * halfA[axis];
+        depth = radius + best;
+        // One feature per face, the sign included
+        feature = 1 + 2 * axis + (c[axis] < 0.0f ? 1 : 0);
+    }
+
+    glm::vec3 n = qA * nLocal;
+    glm::vec3 surface = posA + qA * q;
+    out[0].normal = n;
+    out[0].depth = depth;
+    // Halfway between the box surface and the deepest point of the sphere
+    out[0].point = surface - 0.5f * depth * n;
+    out[0].feature = feature;
+    return 1;
+}
+
+
+// --------------------------------------------------------------
+//      Solver
+// --------------------------------------------------------------
+RigidWorld::RigidWorld(): gravity(0.0f, -10.f, 0.0f), iterations(10), friction(0.5f), baumgarte(0.2f), slop(0.005f), margin(0.01f), warmStart(true) {};
+
+size_t RigidWorld::nContacts() const {
+    size_t n = 0;
+    for (std::unordered_map<uint64_t, Manifold>::const_iterator it = manifolds.begin(); it != manifolds.end(); ++it)
+        n += it->second.contacts.size();
+    return n;
+}
+
+void RigidWorld::gather(const std::vector<Cube>& boxes, const std::vector<Sphere>& spheres) {
+    bodies.resize(boxes.size() + spheres.size());
+
+    for (size_t i = 0; i != boxes.size(); ++i) {
+        const Cube& c = boxes[i];
+        Body& b = bodies[i];
+        b.pos = c.pos;
+        b.orient = c.orient;
+        b.vel = c.vel;
+        b.angVel = c.angVel;
+        b.half = 0.5f * c.size;
+        b.radius = 0.0f;
+        b.invM = c.m > 0.0f ? 1.0f / c.m : 0.0f;
+        b.invI = invInertiaWorld(c);
+        b.box = true;
+    }
+    for (size_t i = 0; i != spheres.size(); ++i) {
+        const Sphere& s = spheres[i];
+        Body& b = bodies[boxes.size() + i];
+        b.pos = s.pos;
+        b.orient = glm::quat(1.0f, 0.0f, 0.0f, 0.0f);
+        b.vel = s.vel;
+        b.angVel = glm::vec3(0.0f);
+        b.half = glm::vec3(s.radius);
+        b.radius = s.radius;
+        b.invM = s.m > 0.0f ? 1.0f / s.m : 0.0f;
+        b.invI = glm::mat3(0.0f);
+        b.box = false;
+    }
+}
+
+void RigidWorld::scatter(std::vector<Cube>& boxes, std::vector<Sphere>& spheres) const {
+    for (size_t i = 0; i != boxes.size(); ++i) {
+        const Body& b = bodies[i];
+        boxes[i].pos = b.pos;
+        boxes[i].orient = b.orient;
+        boxes[i].vel = b.vel;
+        boxes[i].angVel = b.angVel;
+    }
+    for (size_t i = 0; i != spheres.size(); ++i) {
+        const Body& b = bodies[boxes.size() + i];
+        spheres[i].pos = b.pos;
+        spheres[i].vel = b.vel;
+    }
+}
+
+void RigidWorld::collide() {
+    // Broadphase: sort and sweep the world AABBs along x
+    struct Bound {
+        glm::vec3 lo, hi;
+        unsigned int body;
+    };
+    std::vector<Bound> bounds(bodies.size());
+    for (size_t i = 0; i != bodies.size(); ++i) {
+        const Body& b = bodies[i];
+        glm::vec3 e(b.radius);
+        if (b.box) {
+            glm::mat3 R = glm::mat3_cast(b.orient);
+            e = glm::abs(R[0]) * b.half.x + glm::abs(R[1]) * b.half.y + glm::abs(R[2]) * b.half.z;
+        }
+        e += glm::vec3(0.5f * margin);
+        bounds[i] = {b.pos - e, b.pos + e, (unsigned int)i};
+    }
+    std::sort(bounds.begin(), bounds.end(), [](const Bound& a, const Bound& b) { return a.lo.x < b.lo.x; });
+
+    std::unordered_map<uint64_t, Manifold> found;
+    Contact contacts[4];
+    for (size_t i = 0; i != bounds.size(); ++i) {
+        for (size_t j = i + 1; j != bounds.size() && bounds[j].lo.x <= bounds[i].hi.x; ++j) {
+            const Bound& bi = bounds[i];
+            const Bound& bj = bounds[j];
+            if (bi.lo.y > bj.hi.y || bj.lo.y > bi.hi.y || bi.lo.z > bj.hi.z || bj.lo.z > bi.hi.z)
+                continue;
+
+            unsigned int a = std::min(bi.body, bj.body);
+            unsigned int b = std::max(bi.body, bj.body);
+            const Body& A = bodies[a];
+            const Body& B = bodies[b];
+            // Nothing to solve between two static bodies, sphere/sphere is left to collision()
+            if ((A.invM == 0.0f && B.invM == 0.0f) || !A.box)
+                continue;
+
+            int n = B.box ? collideBoxBox(A.pos, A.orient, A.half, B.pos, B.orient, B.half, margin, contacts)
+                          : collideBoxSphere(A.pos, A.orient, A.half, B.pos, B.radius, margin, contacts);
+            if (n == 0)
+                continue;
+
+            uint64_t key = (uint64_t(a) << 32) | b;
+            Manifold& m = found[key];
+            m.a = a;
+            m.b = b;
+            m.contacts.assign(contacts, contacts + n);
+
+            // Warm start: take over the impulses of the same feature last frame
+            std::unordered_map<uint64_t, Manifold>::iterator old = manifolds.find(key);
+            if (old == manifolds.end() || !warmStart)
+                continue;
+            for (std::vector<Contact>::iterator c = m.contacts.begin(); c != m.contacts.end(); ++c) {
+                for (std::vector<Contact>::iterator o = old->second.contacts.begin(); o != old->second.contacts.end(); ++o) {
+                    if (o->feature == c->feature) {
+                        c->Pn = o->Pn;
+                        c->Pt1 = o->Pt1;
+                        c->Pt2 = o->Pt2;
+                        break;
+                    }
+                }
+            }
+        }
+    }
+    manifolds.swap(found);
+}
+
+void RigidWorld::applyImpulse(Contact& c, Body& a, Body& b, glm::vec3 P) {
+    a.vel -= a.invM * P;
+    a.angVel -= a.invI * glm::cross(c.rA, P);
+    b.vel += b.invM * P;
+    b.angVel += b.invI * glm::cross(c.rB, P);
+}
+
+void RigidWorld::preStep(float dt) {
+    for (std::unordered_map<uint64_t, Manifold>::iterator m = manifolds.begin(); m != manifolds.end(); ++m) {
+        Body& a = bodies[m->second.a];
+        Body& b = bodies[m->second.b];
+
+        for (std::vector<Contact>::iterator c = m->second.contacts.begin(); c != m->second.contacts.end(); ++c) {
+            glm::vec3 n = c->normal;
+            c->rA = c->point - a.pos;
+            c->rB = c->point - b.pos;
+
+            // Stable tangent basis from the normal, so friction impulses can be warm started too
+            if (glm::abs(n.x) >= 0.57735f)
+                c->t1 = glm::normalize(glm::vec3(n.y, -n.x, 0.0f));
+            else
+                c->t1 = glm::normalize(glm::vec3(0.0f, n.z, -n.y));
+            c->t2 = glm::cross(n, c->t1);
+
+            // Effective mass along a direction: 1 / (1/ma + 1/mb + angular terms)
+            auto effectiveMass = [&](glm::vec3 dir) {
+                glm::vec3 ra = glm::cross(a.invI * glm::cross(c->rA, dir), c->rA);
+                glm::vec3 rb = glm::cross(b.invI * glm::cross(c->rB, dir), c->rB);
+                float k = a.invM + b.invM + glm::dot(ra + rb, dir);
+                return k > 0.0f ? 1.0f / k : 0.0f;
+            };
+            c->massN = effectiveMass(n);
+            c->massT1 = effectiveMass(c->t1);
+            c->massT2 = effectiveMass(c->t2);
+
+            // A gap may close within the step but no more, a penetration is pushed out over a few steps
+            if (c->depth < 0.0f)
+                c->bias = c->depth / dt;
+            else
+                c->bias = baumgarte / dt * glm::max(0.0f, c->depth - slop);
+
+            if (warmStart)
+                applyImpulse(*c, a, b, c->Pn * n + c->Pt1 * c->t1 + c->Pt2 * c->t2);
+            else
+                c->Pn = c->Pt1 = c->Pt2 = 0.0f;
+        }
+    }
+}
+
+void RigidWorld::solve() {
+    for (std::unordered_map<uint64_t, Manifold>::iterator m = manifolds.begin(); m != manifolds.end(); ++m) {
+        Body& a = bodies[m->second.a];
+        Body& b = bodies[m->second.b];
+
+        for (std::vector<Contact>::iterator c = m->second.contacts.begin(); c != m->second.contacts.end(); ++c) {
+            auto relativeVelocity = [&]() {
+                return b.vel + glm::cross(b.angVel, c->rB) - a.vel - glm::cross(a.angVel, c->rA);
+            };
+
+            // Normal: accumulated impulse stays positive (bodies can only push)
+            float vn = glm::dot(relativeVelocity(), c->normal);
+            float dPn = c->massN * (-vn + c->bias);
+            float Pn = glm::max(c->Pn + dPn, 0.0f);
+            dPn = Pn - c->Pn;
+            c->Pn = Pn;
+            applyImpulse(*c, a, b, dPn * c->normal);
+
+            // Friction: accumulated impulse stays in the cone given by the normal impulse
+            float maxPt = friction * c->Pn;
+            glm::vec3 dv = relativeVelocity();
+            float dPt1 = c->massT1 * -glm::dot(dv, c->t1);
+            float Pt1 = glm::clamp(c->Pt1 + dPt1, -maxPt, maxPt);
+            dPt1 = Pt1 - c->Pt1;
+            c->Pt1 = Pt1;
+
+            float dPt2 = c->massT2 * -glm::dot(dv, c->t2);
+            float Pt2 = glm::clamp(c->Pt2 + dPt2, -maxPt, maxPt);
+            dPt2 = Pt2 - c->Pt2;
+            c->Pt2 = Pt2;
+
+            applyImpulse(*c, a, b, dPt1 * c->t1 + dPt2 * c->t2);
+        }
+    }
+}
+
+void RigidWorld::integrate(float dt) {
+    for (std::vector<Body>::iterator b = bodies.begin(); b != bodies.end(); ++b) {
+        if (b->invM == 0.0f)
+            continue;
+        b->pos += b->vel * dt;
+
+        // dq/dt = 1/2 w q
+        glm::quat spin(0.0f, b->angVel.x, b->angVel.y, b->angVel.z);
+        b->orient = glm::normalize(b->orient + (0.5f * dt) * (spin * b->orient));
+    }
+}
+
+void RigidWorld::step(std::vector<Cube>& boxes, std::vector<Sphere>& spheres, float dt) {
+    if (dt <= 0.0f)
+        return;
+
+    gather(boxes, spheres);
+
+    for (std::vector<Body>::iterator b = bodies.begin(); b != bodies.end(); ++b)
+        if (b->invM != 0.0f)
+            b->vel += gravity * dt;
+
+    collide();
+    preStep(dt);
+    for (unsigned int i = 0; i != iterations; ++i)
+        solve();
+    integrate(dt);
+
+    scatter(boxes, spheres);
+}
@@ -34,17 +34,27 @@ void mouse_callback(GLFWwindow* window, double xposIn, double yposIn)
     lastY = ypos;
 
     camera.ProcessMouseMovement(xoffset, yoffset);
+    session.add(REPLAY_MOUSE, 0, xoffset, yoffset);
 }
 
 void scroll_callback(GLFWwindow* window, double xoffset, double yoffset)
 {
     camera.ProcessMouseScroll(static_cast<float>(yoffset));
+    session.add(REPLAY_SCROLL, 0, static_cast<float>(yoffset));
 }
 
 void click_callback(GLFWwindow* window, int button, int action, int mods)
 {
-    if (button == GLFW_MOUSE_BUTTON_LEFT)
+    if (button == GLFW_MOUSE_BUTTON_LEFT) {
         camera.ProcessMouseClick(action == GLFW_PRESS);
+        session.add(REPLAY_CLICK, action == GLFW_PRESS);
+    }
+}
+
+static void moveCamera(Camera_Movement direction)
+{
+    camera.ProcessKeyboard(direction, deltaTime);
+    session.add(REPLAY_KEY, direction, deltaTime);
 }
 
 void processInput(GLFWwindow* window)
@@ -54,13 +64,13 @@ void processInput(GLFWwindow* window)
 
     const float cameraSpeed = WASD_SPEED * deltaTime;
     if (glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS)
-        camera.ProcessKeyboard(FORWARD, deltaTime);
+        moveCamera(FORWARD);
     if (glfwGetKey(window, GLFW_KEY_S) == GLFW_PRESS)
-        camera.ProcessKeyboard(BACKWARD, deltaTime);
+        moveCamera(BACKWARD);
     if (glfwGetKey(window, GLFW_KEY_A) == GLFW_PRESS)
-        camera.ProcessKeyboard(LEFT, deltaTime);
+        moveCamera(LEFT);
     if (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS)
-        camera.ProcessKeyboard(RIGHT, deltaTime);
+        moveCamera(RIGHT);
 }
 
 int logShaderCompile(const unsigned int shaderId, const char* shaderType)
@@ -92,13 +102,13 @@ int logProgramLink(const unsigned int shaderProgram)
 };
 
 Sphere* ObjectRayCast(Ray& ray, std::vector<Sphere>& entities){
-    Sphere *ret;
+    Sphere *ret = nullptr;
     float t = std::numeric_limits<float>::max();
 
     for (std::vector<Sphere>::iterator it = entities.begin(); it != entities.end(); ++it){
         float new_t;
         if (it->intersects(ray, new_t)) {
-            if (abs(new_t) < abs(t)) {
+            if (new_t < t) {
                 t = new_t;
                 ret = &(*it);
             }
@@ -107,3 +117,24 @@ Sphere* ObjectRayCast(Ray& ray, std::vector<Sphere>& entities){
 
     return ret;
 };
+
+Cube* ObjectRayCast(Ray& ray, std::vector<Cube>& entities){
+    Cube *ret = nullptr;
+    float t = std::numeric_limits<float>::max();
+
+    for (std::vector<Cube>::iterator it = entities.begin(); it != entities.end(); ++it){
+        float new_t;
+        if (it->intersects(ray, new_t)) {
+            if (new_t < t) {
+                t = new_t;
+                ret = &(*it);
+            }
+        }
+    }
+
+    return ret;
+};
+
+RayHit ObjectRayCast(const Ray& ray, const std::vector<Sphere>& entities, const BVH& bvh){
+    return bvh.intersect(ray, entities);
+};
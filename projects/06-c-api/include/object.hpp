@@ -0,0 +1,15 @@
+#ifndef OBJECT_HPP
+#define OBJECT_HPP
+
+#include <glm/glm.hpp>
+
+// Same layout as the Sphere of 01-bouncing_ball and 02-pendulum, without the meshes
+struct Sphere {
+    glm::vec3 pos;
+    glm::vec3 vel;
+    glm::vec3 color;
+    float radius;
+    float m;
+};
+
+#endif
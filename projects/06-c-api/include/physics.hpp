@@ -0,0 +1,27 @@
+#ifndef PHYSICS_HPP
+#define PHYSICS_HPP
+
+#include <vector>
+#include <glm/glm.hpp>
+#include "object.hpp"
+
+// Kinetic plus potential energy of the sphere (zero potential at y = 0)
+float energy(const Sphere& s);
+// The two terms of energy() in double, sums over many spheres keep their precision
+void energyTerms(const Sphere& s, double& kinetic, double& potential);
+void collision(Sphere& s1, Sphere& s2);
+// Velocity exchange along the contact normal (from s1 to s2)
+void bounce(Sphere& s1, Sphere& s2, glm::vec3 normal);
+// The box is a cube of side 2 * halfBox, open at the top
+void move(Sphere& s, float dt, glm::vec3 centerBox, float halfBox = 0.5f);
+
+// Continuous collision detection for the spheres moving more than threshold * radius in a step:
+// the sphere is advanced from one time of impact to the next (walls, then the other spheres
+// inflated by its radius) so it cannot tunnel, whatever the number of substeps.
+bool isFast(const Sphere& s, float dt, float threshold = 0.5f);
+void moveSwept(std::vector<Sphere>& spheres, size_t i, float dt, glm::vec3 centerBox, float halfBox = 0.5f);
+
+// Pendulum of 02-pendulum: the sphere is kept at distance r of center
+void moveConstrained(Sphere& s, float dt, glm::vec3 center, float r);
+
+#endif
@@ -0,0 +1,66 @@
+#ifndef PHYSICS_SIM_H
+#define PHYSICS_SIM_H
+
+/*
+ * C interface to the simulations, for C, Fortran (bind(c)) or Python (ctypes).
+ *
+ * A world is created, stepped any number of steps per call and destroyed. The state is not
+ * copied out: the accessors return borrowed pointers into the world, valid until it is
+ * destroyed. Arrays are strided, element i of the array starts at (char*)p + i * stride,
+ * with stride in bytes, and holds x, y, z floats. They can be written too, to set a state.
+ * A world must not be used from two threads at once, different worlds are independent.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(_WIN32)
+    #if defined(PHYSICS_SIM_BUILD)
+        #define PHYSICS_SIM_API __declspec(dllexport)
+    #else
+        #define PHYSICS_SIM_API __declspec(dllimport)
+    #endif
+#else
+    #define PHYSICS_SIM_API __attribute__((visibility("default")))
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Bouncing balls (01-bouncing_ball): spheres of the same radius in a box open at the top.
+ * They start uniformly in the box with a small random velocity, drawn from seed by a generator
+ * of their own: the same seed gives the same world, and the host rand() is left alone.
+ * create returns NULL on bad arguments or when the spheres do not fit in memory. */
+typedef struct PhysBallWorld PhysBallWorld;
+
+PHYSICS_SIM_API PhysBallWorld* phys_ball_create(uint32_t n_spheres, float radius, float box_size, uint32_t seed);
+PHYSICS_SIM_API void phys_ball_destroy(PhysBallWorld* world);
+/* n_steps steps of dt, each one split in substeps (2 by default). Returns 0, -1 on bad arguments. */
+PHYSICS_SIM_API int phys_ball_step(PhysBallWorld* world, float dt, uint32_t n_steps);
+PHYSICS_SIM_API void phys_ball_set_substeps(PhysBallWorld* world, uint32_t n_substeps);
+
+PHYSICS_SIM_API uint32_t phys_ball_count(const PhysBallWorld* world);
+PHYSICS_SIM_API double phys_ball_time(const PhysBallWorld* world);
+PHYSICS_SIM_API double phys_ball_energy(const PhysBallWorld* world);
+PHYSICS_SIM_API float* phys_ball_positions(PhysBallWorld* world, size_t* stride);
+PHYSICS_SIM_API float* phys_ball_velocities(PhysBallWorld* world, size_t* stride);
+PHYSICS_SIM_API float* phys_ball_radii(PhysBallWorld* world, size_t* stride);
+
+/* Pendulum (02-pendulum): one sphere kept at length of the origin, 100 substeps by default */
+typedef struct PhysPendulumWorld PhysPendulumWorld;
+
+PHYSICS_SIM_API PhysPendulumWorld* phys_pendulum_create(float length, uint32_t n_substeps);
+PHYSICS_SIM_API void phys_pendulum_destroy(PhysPendulumWorld* world);
+PHYSICS_SIM_API int phys_pendulum_step(PhysPendulumWorld* world, float dt, uint32_t n_steps);
+
+PHYSICS_SIM_API double phys_pendulum_time(const PhysPendulumWorld* world);
+PHYSICS_SIM_API double phys_pendulum_energy(const PhysPendulumWorld* world);
+PHYSICS_SIM_API float* phys_pendulum_position(PhysPendulumWorld* world);
+PHYSICS_SIM_API float* phys_pendulum_velocity(PhysPendulumWorld* world);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,16 @@
+project "06-c-api"
+    kind "SharedLib"
+
+    includedirs
+    {
+        "../../deps/glm",
+        "include"
+    }
+
+    files "src/**"
+
+    links { "GLM" }
+
+    -- Exports the phys_* functions (dllexport on Windows), only them
+    defines { "PHYSICS_SIM_BUILD" }
+    visibility "Hidden"
@@ -0,0 +1,216 @@
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <vector>
+
+#include "object.hpp"
+#include "physics.hpp"
+
+
+void energyTerms(const Sphere& s, double& kinetic, double& potential){
+    glm::dvec3 g(0.0, -10.0, 0.0);
+    glm::dvec3 v(s.vel);
+    kinetic = 0.5 * s.m * glm::dot(v, v);
+    potential = -g.y * s.m * s.pos.y;
+};
+
+float energy(const Sphere& s){
+    double kinetic, potential;
+    energyTerms(s, kinetic, potential);
+    return kinetic + potential;
+};
+
+
+void collision(Sphere& s1, Sphere& s2){
+    glm::vec3 normal(s2.pos - s1.pos);
+    float d = glm::length(normal);
+
+    if (d > s1.radius + s2.radius)
+        return;
+
+    normal /= d;
+
+    float corr = (s1.radius + s2.radius - d) / 2.0f;
+
+    s1.pos -= corr * normal;
+    s2.pos += corr * normal;
+
+    bounce(s1, s2, normal);
+};
+
+
+void bounce(Sphere& s1, Sphere& s2, glm::vec3 normal){
+    // elasticity
+    float e = 0.95f;
+
+    float v1n = glm::dot(s1.vel, normal);
+    float v2n = glm::dot(s2.vel, normal);
+
+    float v1n_new = ((s1.m * v1n) + (s2.m * v2n) - s2.m * (v1n - v2n) * e)/(s1.m + s2.m);
+    float v2n_new = ((s1.m * v1n) + (s2.m * v2n) - s1.m * (v2n - v1n) * e)/(s1.m + s2.m);
+
+    glm::vec3 v1t = s1.vel - glm::dot(s1.vel, normal) * normal;
+    glm::vec3 v2t = s2.vel - glm::dot(s2.vel, normal) * normal;
+
+    s1.vel = v1t + v1n_new * normal;
+    s2.vel = v2t + v2n_new * normal;
+};
+
+
+void move(Sphere& s, float dt, glm::vec3 centerBox, float halfBox){
+    /*
+     F = ma
+     F = m dv/dt
+        dv = (F/m) * dt
+        vi - vi-1 = (F/m) * dt
+        vi = vi-1 + (F/m) * dt
+    v = dx/dt
+        dx = v * dt
+        xi = xi-1 + v * dt
+    */
+    glm::vec3 g(0.0f, -10.f, 0.0f);
+
+    s.vel += g * dt;
+    s.pos += s.vel * dt;
+
+    if (s.pos.y - s.radius < centerBox.y - halfBox){
+        // Remove the potential energy gained from the velocity
+        // dE = 0 => mgdh = -mvdv => dv = -gdh/v => v = v - gdh/v
+        // dh = centerBox.y - halfBox - (s.pos.y - s.radius) ;
+        // s.vel.y -= g.y * dh / s.vel.y;
+        s.pos.y = centerBox.y - halfBox + s.radius;
+        s.vel.y = -s.vel.y;
+    }
+    if (s.pos.x + s.radius > centerBox.x + halfBox ){
+        s.pos.x = centerBox.x + halfBox - s.radius;
+        s.vel.x = -s.vel.x;
+    } else if (s.pos.x - s.radius < centerBox.x - halfBox){
+        s.pos.x = centerBox.x - halfBox + s.radius;
+        s.vel.x = -s.vel.x;
+    }
+    if (s.pos.z + s.radius > centerBox.z + halfBox ){
+        s.pos.z = centerBox.z + halfBox - s.radius;
+        s.vel.z = -s.vel.z;
+    } else if (s.pos.z - s.radius < centerBox.z - halfBox){
+        s.pos.z = centerBox.z - halfBox + s.radius;
+        s.vel.z = -s.vel.z;
+    }
+}
+
+
+bool isFast(const Sphere& s, float dt, float threshold){
+    glm::vec3 g(0.0f, -10.f, 0.0f);
+    glm::vec3 d = (s.vel + g * dt) * dt;
+    float limit = threshold * s.radius;
+    return glm::dot(d, d) > limit * limit;
+}
+
+
+// Fraction of the displacement d after which s touches a wall of the box, wall = -1 if none
+static float wallImpact(const Sphere& s, glm::vec3 d, glm::vec3 centerBox, float halfBox, int& wall){
+    float toi = std::numeric_limits<float>::max();
+    wall = -1;
+    for (int axis = 0; axis != 3; ++axis) {
+        // The box is open at the top
+        for (int side = (axis == 1 ? 0 : 1); side >= 0; --side) {
+            float plane = side ? centerBox[axis] + halfBox - s.radius : centerBox[axis] - halfBox + s.radius;
+            float gap = side ? plane - s.pos[axis] : s.pos[axis] - plane;
+            float closing = side ? d[axis] : -d[axis];
+            if (closing <= 0.0f || gap < 0.0f || gap > closing)
+                continue;
+            if (gap / closing < toi) {
+                toi = gap / closing;
+                wall = axis;
+            }
+        }
+    }
+    return toi;
+}
+
+// Fraction of the displacement d after which s touches o: ray against o inflated by the radius of s
+static float sphereImpact(const Sphere& s, glm::vec3 d, const Sphere& o){
+    float r = s.radius + o.radius;
+    glm::vec3 p = s.pos - o.pos;
+    float c = glm::dot(p, p) - r * r;
+    float b = glm::dot(p, d);
+    float a = glm::dot(d, d);
+
+    // Already overlapping (left to collision()) or moving away
+    if (c < 0.0f || b >= 0.0f)
+        return std::numeric_limits<float>::max();
+
+    float delta = b * b - a * c;
+    if (delta < 0.0f)
+        return std::numeric_limits<float>::max();
+
+    float t = (-b - std::sqrt(delta)) / a;
+    return t <= 1.0f ? std::max(t, 0.0f) : std::numeric_limits<float>::max();
+}
+
+
+void moveSwept(std::vector<Sphere>& spheres, size_t i, float dt, glm::vec3 centerBox, float halfBox){
+    // Same integration as move(): velocity first, then the position along a straight segment
+    glm::vec3 g(0.0f, -10.f, 0.0f);
+    Sphere& s = spheres[i];
+    s.vel += g * dt;
+
+    // Walk the segment from impact to impact, the other spheres are frozen meanwhile
+    const int MAX_IMPACTS = 8;
+    float remaining = dt;
+    for (int n = 0; n != MAX_IMPACTS && remaining > 0.0f; ++n) {
+        glm::vec3 d = s.vel * remaining;
+
+        int wall;
+        float toi = wallImpact(s, d, centerBox, halfBox, wall);
+        size_t other = spheres.size();
+        for (size_t j = 0; j != spheres.size(); ++j) {
+            if (j == i)
+                continue;
+            float t = sphereImpact(s, d, spheres[j]);
+            if (t < toi) {
+                toi = t;
+                other = j;
+            }
+        }
+
+        if (toi > 1.0f) {
+            s.pos += d;
+            break;
+        }
+
+        s.pos += toi * d;
+        remaining *= 1.0f - toi;
+        if (other != spheres.size()) {
+            bounce(s, spheres[other], glm::normalize(spheres[other].pos - s.pos));
+        } else {
+            s.vel[wall] = -s.vel[wall];
+        }
+    }
+
+    // Keep the walls as hard limits in case the impacts ran out
+    move(s, 0.0f, centerBox, halfBox);
+}
+
+
+void moveConstrained(Sphere& s, float dt, glm::vec3 center, float r){
+    /*
+    v = v + (F/m) * dt
+    p <- x                  save initial position
+    x = x + v * dt          move the particle
+    x = constraint(x)       apply constraints
+    v = (x - p) / dt
+    */
+    glm::vec3 g(0.0f, -10.f, 0.0f);
+
+    s.vel += g * dt;
+    glm::vec3 p = s.pos;
+    s.pos += s.vel * dt;
+
+    // constraint
+    glm::vec3 dir = glm::normalize(s.pos - center);
+    s.pos = center + r * dir;
+
+    s.vel = (s.pos - p) / dt;
+}
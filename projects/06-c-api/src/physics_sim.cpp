@@ -0,0 +1,192 @@
+#include <glm/glm.hpp>
+
+#include <cmath>
+#include <new>
+#include <random>
+#include <vector>
+
+#include "physics_sim.h"
+#include "object.hpp"
+#include "physics.hpp"
+
+struct PhysBallWorld {
+    std::vector<Sphere> spheres;
+    glm::vec3 center = glm::vec3(0.0f);
+    float halfBox = 0.5f;
+    uint32_t n_substeps = 2;
+    float ccd_threshold = 0.5f;
+    double time = 0.0;
+};
+
+struct PhysPendulumWorld {
+    Sphere sphere;
+    glm::vec3 center = glm::vec3(0.0f);
+    float length = 1.0f;
+    uint32_t n_substeps = 100;
+    double time = 0.0;
+};
+
+
+PhysBallWorld* phys_ball_create(uint32_t n_spheres, float radius, float box_size, uint32_t seed) {
+    if (radius <= 0.0f || box_size <= 0.0f)
+        return nullptr;
+    PhysBallWorld* world = new (std::nothrow) PhysBallWorld();
+    if (world == nullptr)
+        return nullptr;
+
+    // No exception may leave a C entry point, the host would terminate
+    try {
+        // Same distributions as the scene of 01-bouncing_ball, scaled to the box. The generator
+        // is the world's own: rand() would be shared with the host and with the other worlds.
+        world->halfBox = 0.5f * box_size;
+        std::mt19937 rng(seed);
+        std::uniform_real_distribution<float> position(-world->halfBox, world->halfBox);
+        std::uniform_real_distribution<float> velocity(-0.001f, 0.001f);
+        std::uniform_real_distribution<float> color(0.0f, 1.0f);
+        auto draw = [&](std::uniform_real_distribution<float>& d) {
+            float x = d(rng);
+            float y = d(rng);
+            float z = d(rng);
+            return glm::vec3(x, y, z);
+        };
+        world->spheres.resize(n_spheres);
+        for (std::vector<Sphere>::iterator it = world->spheres.begin(); it != world->spheres.end(); ++it) {
+            it->pos = draw(position);
+            it->vel = draw(velocity);
+            it->color = draw(color);
+            it->radius = radius;
+            it->m = M_PI * it->radius * it->radius;
+        }
+    } catch (...) {
+        delete world;
+        return nullptr;
+    }
+    return world;
+}
+
+void phys_ball_destroy(PhysBallWorld* world) {
+    delete world;
+}
+
+int phys_ball_step(PhysBallWorld* world, float dt, uint32_t n_steps) {
+    if (world == nullptr || !(dt > 0.0f))
+        return -1;
+
+    std::vector<Sphere>& spheres = world->spheres;
+    float sub_dt = dt / world->n_substeps;
+    // The update of the viewer, without the drawing
+    for (uint32_t n = 0; n != n_steps; ++n) {
+        for (std::vector<Sphere>::iterator it = spheres.begin(); it != spheres.end(); ++it) {
+            for (uint32_t step = 0; step != world->n_substeps; ++step) {
+                if (isFast(*it, sub_dt, world->ccd_threshold))
+                    moveSwept(spheres, it - spheres.begin(), sub_dt, world->center, world->halfBox);
+                else
+                    move(*it, sub_dt, world->center, world->halfBox);
+
+                for (std::vector<Sphere>::iterator it2 = spheres.begin(); it2 != spheres.end(); ++it2) {
+                    if (it != it2)
+                        collision(*it, *it2);
+                }
+            }
+        }
+        world->time += dt;
+    }
+    return 0;
+}
+
+void phys_ball_set_substeps(PhysBallWorld* world, uint32_t n_substeps) {
+    if (world != nullptr && n_substeps != 0)
+        world->n_substeps = n_substeps;
+}
+
+uint32_t phys_ball_count(const PhysBallWorld* world) {
+    return world == nullptr ? 0 : (uint32_t)world->spheres.size();
+}
+
+double phys_ball_time(const PhysBallWorld* world) {
+    return world == nullptr ? 0.0 : world->time;
+}
+
+double phys_ball_energy(const PhysBallWorld* world) {
+    double total = 0.0;
+    if (world == nullptr)
+        return total;
+    for (std::vector<Sphere>::const_iterator it = world->spheres.begin(); it != world->spheres.end(); ++it) {
+        double kinetic, potential;
+        energyTerms(*it, kinetic, potential);
+        total += kinetic + potential;
+    }
+    return total;
+}
+
+// The spheres never move in memory after create: the pointers stay valid until destroy
+float* phys_ball_positions(PhysBallWorld* world, size_t* stride) {
+    if (stride != nullptr)
+        *stride = sizeof(Sphere);
+    return world == nullptr || world->spheres.empty() ? nullptr : &world->spheres[0].pos.x;
+}
+
+float* phys_ball_velocities(PhysBallWorld* world, size_t* stride) {
+    if (stride != nullptr)
+        *stride = sizeof(Sphere);
+    return world == nullptr || world->spheres.empty() ? nullptr : &world->spheres[0].vel.x;
+}
+
+float* phys_ball_radii(PhysBallWorld* world, size_t* stride) {
+    if (stride != nullptr)
+        *stride = sizeof(Sphere);
+    return world == nullptr || world->spheres.empty() ? nullptr : &world->spheres[0].radius;
+}
+
+
+PhysPendulumWorld* phys_pendulum_create(float length, uint32_t n_substeps) {
+    if (length <= 0.0f)
+        return nullptr;
+    PhysPendulumWorld* world = new (std::nothrow) PhysPendulumWorld();
+    if (world == nullptr)
+        return nullptr;
+
+    // Initial state of 02-pendulum
+    world->length = length;
+    world->n_substeps = n_substeps == 0 ? 100 : n_substeps;
+    Sphere& sphere = world->sphere;
+    sphere.pos = length * glm::normalize(glm::vec3(0.7f, 0.7f, 0.0f));
+    sphere.vel = glm::vec3(-1.0f, -1.0f, 1.0f);
+    sphere.color = glm::vec3(1.0f);
+    sphere.radius = 0.05f;
+    sphere.m = M_PI * sphere.radius * sphere.radius;
+    return world;
+}
+
+void phys_pendulum_destroy(PhysPendulumWorld* world) {
+    delete world;
+}
+
+int phys_pendulum_step(PhysPendulumWorld* world, float dt, uint32_t n_steps) {
+    if (world == nullptr || !(dt > 0.0f))
+        return -1;
+
+    float sub_dt = dt / world->n_substeps;
+    for (uint32_t n = 0; n != n_steps; ++n) {
+        for (uint32_t step = 0; step != world->n_substeps; ++step)
+            moveConstrained(world->sphere, sub_dt, world->center, world->length);
+        world->time += dt;
+    }
+    return 0;
+}
+
+double phys_pendulum_time(const PhysPendulumWorld* world) {
+    return world == nullptr ? 0.0 : world->time;
+}
+
+double phys_pendulum_energy(const PhysPendulumWorld* world) {
+    return world == nullptr ? 0.0 : energy(world->sphere);
+}
+
+float* phys_pendulum_position(PhysPendulumWorld* world) {
+    return world == nullptr ? nullptr : &world->sphere.pos.x;
+}
+
+float* phys_pendulum_velocity(PhysPendulumWorld* world) {
+    return world == nullptr ? nullptr : &world->sphere.vel.x;
+}